@@ -0,0 +1,331 @@
+// Standalone benchmark for CIconLookup over a synthetic icon theme and applications tree.
+// Everything lives in a temporary directory; HOME, XDG_* and the GSettings backend are pointed
+// at it so the real user setup is never read or written.
+
+#include "IconLookup.hpp"
+
+#include <gio/gio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+struct SBenchOptions {
+    int  icons      = 4000;
+    int  apps       = 2000;
+    int  iterations = 20;
+    int  queries    = 20000;
+    bool keep       = false;
+};
+
+// Counts syscalls made by this process (and threads it spawns) through the raw_syscalls tracepoint.
+// Needs perf_event_paranoid <= 1 or CAP_PERFMON; without it every count reads as n/a.
+class CSyscallCounter {
+  public:
+    CSyscallCounter() {
+        uint64_t id = 0;
+        for (const char* path : {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id", "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"}) {
+            std::ifstream file(path);
+            if (file >> id)
+                break;
+        }
+
+        if (!id)
+            return;
+
+        perf_event_attr attr{};
+        attr.type           = PERF_TYPE_TRACEPOINT;
+        attr.size           = sizeof(attr);
+        attr.config         = id;
+        attr.disabled       = 1;
+        attr.inherit        = 1;
+        attr.exclude_kernel = 0;
+
+        m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~CSyscallCounter() {
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    bool available() const {
+        return m_fd >= 0;
+    }
+
+    void start() {
+        if (m_fd < 0)
+            return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    int64_t stop() {
+        if (m_fd < 0)
+            return -1;
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        uint64_t count = 0;
+        if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        return count;
+    }
+
+  private:
+    int m_fd = -1;
+};
+
+struct SPhaseResult {
+    std::string          name;
+    std::vector<int64_t> samplesNs;
+    int64_t              syscalls = -1; // total over all samples, -1 if unavailable
+};
+
+static CSyscallCounter g_syscalls;
+
+static SPhaseResult measure(const std::string& name, int runs, const std::function<void(int)>& fn) {
+    SPhaseResult result{name, {}, -1};
+    result.samplesNs.reserve(runs);
+
+    int64_t syscalls = 0;
+    for (int i = 0; i < runs; i++) {
+        g_syscalls.start();
+        const auto START = std::chrono::steady_clock::now();
+        fn(i);
+        const auto END   = std::chrono::steady_clock::now();
+        const auto COUNT = g_syscalls.stop();
+
+        result.samplesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(END - START).count());
+        syscalls = COUNT < 0 || syscalls < 0 ? -1 : syscalls + COUNT;
+    }
+
+    result.syscalls = syscalls;
+    return result;
+}
+
+static int64_t percentile(std::vector<int64_t> samples, double p) {
+    if (samples.empty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    const size_t index = std::min(samples.size() - 1, (size_t)(p * (samples.size() - 1) + 0.5));
+    return samples[index];
+}
+
+static std::string formatNs(int64_t ns) {
+    char buf[32];
+    if (ns >= 10'000'000)
+        snprintf(buf, sizeof(buf), "%.1f ms", ns / 1e6);
+    else if (ns >= 10'000)
+        snprintf(buf, sizeof(buf), "%.1f us", ns / 1e3);
+    else
+        snprintf(buf, sizeof(buf), "%ld ns", (long)ns);
+    return buf;
+}
+
+static void printResult(const SPhaseResult& result) {
+    char syscalls[32] = "n/a";
+    if (result.syscalls >= 0)
+        snprintf(syscalls, sizeof(syscalls), "%.1f", (double)result.syscalls / result.samplesNs.size());
+
+    printf("%-24s %8zu %12s %12s %14s\n", result.name.c_str(), result.samplesNs.size(), formatNs(percentile(result.samplesNs, 0.5)).c_str(),
+           formatNs(percentile(result.samplesNs, 0.99)).c_str(), syscalls);
+}
+
+static void touch(const fs::path& path, const std::string& contents = "") {
+    std::ofstream file(path);
+    file << contents;
+}
+
+static std::string iconName(int i) {
+    return "bench-app-" + std::to_string(i);
+}
+
+// The theme the plugin will pick: GSettings comes first, and the memory backend answers with the schema default.
+static std::string currentThemeName() {
+    GSettings*  settings = g_settings_new("org.gnome.desktop.interface");
+    std::string theme    = "hicolor";
+    if (settings) {
+        gchar* value = g_settings_get_string(settings, "icon-theme");
+        if (value && value[0])
+            theme = value;
+        g_free(value);
+        g_object_unref(settings);
+    }
+    return theme;
+}
+
+static void writeTheme(const fs::path& dir, const std::string& name, const std::string& inherits, const std::vector<int>& sizes, int icons, int stride) {
+    std::string directories;
+    std::string sections;
+    for (int size : sizes) {
+        const std::string sub = size ? std::to_string(size) + "x" + std::to_string(size) + "/apps" : "scalable/apps";
+        directories += (directories.empty() ? "" : ",") + sub;
+        sections += "\n[" + sub + "]\nContext=Applications\n";
+        sections += size ? "Size=" + std::to_string(size) + "\nType=Threshold\n" : "Size=128\nMinSize=8\nMaxSize=512\nType=Scalable\n";
+        fs::create_directories(dir / name / sub);
+    }
+
+    touch(dir / name / "index.theme", "[Icon Theme]\nName=" + name + "\nInherits=" + inherits + "\nDirectories=" + directories + "\n" + sections);
+
+    // every stride-th icon exists in this theme, spread over the size directories like real themes
+    for (int i = 0; i < icons; i += stride) {
+        for (size_t s = 0; s < sizes.size(); s++) {
+            if ((i + s) % 3 == 0)
+                continue;
+            const std::string sub = sizes[s] ? std::to_string(sizes[s]) + "x" + std::to_string(sizes[s]) + "/apps" : "scalable/apps";
+            touch(dir / name / sub / (iconName(i) + (sizes[s] ? ".png" : ".svg")));
+        }
+    }
+}
+
+static void writeApplications(const fs::path& dir, int apps, int icons) {
+    fs::create_directories(dir);
+
+    for (int i = 0; i < apps; i++) {
+        std::string entry = "[Desktop Entry]\nType=Application\nName=Bench App " + std::to_string(i) + "\nExec=bench-app-" + std::to_string(i) + " %U\n";
+        entry += "Icon=" + iconName(i % icons) + "\n";
+        if (i % 2 == 0)
+            entry += "StartupWMClass=BenchApp" + std::to_string(i) + "\n";
+        entry += "Categories=Utility;\nKeywords=bench;synthetic;\n\n[Desktop Action new-window]\nName=New Window\nExec=bench-app-" + std::to_string(i) + " --new\n";
+
+        touch(dir / ("org.bench.App" + std::to_string(i) + ".desktop"), entry);
+    }
+}
+
+static std::string appClass(int i) {
+    // alternate between the ways windows usually identify themselves
+    switch (i % 3) {
+        case 0: return i % 2 == 0 ? "BenchApp" + std::to_string(i) : "org.bench.App" + std::to_string(i);
+        case 1: return "org.bench.App" + std::to_string(i);
+        default: return "Bench App " + std::to_string(i);
+    }
+}
+
+static bool parseOptions(int argc, char** argv, SBenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg  = argv[i];
+        const char*       next = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg == "--icons" && next)
+            options.icons = std::atoi(argv[++i]);
+        else if (arg == "--apps" && next)
+            options.apps = std::atoi(argv[++i]);
+        else if (arg == "--iterations" && next)
+            options.iterations = std::atoi(argv[++i]);
+        else if (arg == "--queries" && next)
+            options.queries = std::atoi(argv[++i]);
+        else if (arg == "--keep")
+            options.keep = true;
+        else {
+            fprintf(stderr, "usage: %s [--icons N] [--apps N] [--iterations N] [--queries N] [--keep]\n", argv[0]);
+            return false;
+        }
+    }
+
+    options.icons      = std::max(1, options.icons);
+    options.apps       = std::max(1, options.apps);
+    options.iterations = std::max(1, options.iterations);
+    options.queries    = std::max(1, options.queries);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    SBenchOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    char        rootTemplate[] = "/tmp/hypricons-bench-XXXXXX";
+    const char* rootDir        = mkdtemp(rootTemplate);
+    if (!rootDir) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const fs::path root = rootDir;
+    fs::create_directories(root / "home");
+    fs::create_directories(root / "cache");
+    fs::create_directories(root / "config");
+
+    setenv("HOME", (root / "home").c_str(), 1);
+    setenv("XDG_DATA_DIRS", (root / "share").c_str(), 1);
+    setenv("XDG_CACHE_HOME", (root / "cache").c_str(), 1);
+    setenv("XDG_CONFIG_HOME", (root / "config").c_str(), 1);
+    setenv("GSETTINGS_BACKEND", "memory", 1);
+    unsetenv("GTK_ICON_THEME");
+
+    const std::string theme = currentThemeName();
+    const fs::path    icons = root / "share" / "icons";
+
+    const auto        GENSTART = std::chrono::steady_clock::now();
+    writeTheme(icons, "hicolor", "", {16, 22, 24, 32, 48, 64, 128, 256, 0}, options.icons, 1);
+    if (theme != "hicolor")
+        writeTheme(icons, theme, "hicolor", {16, 24, 32, 48, 64, 96, 128, 0}, options.icons, 2);
+    writeApplications(root / "share" / "applications", options.apps, options.icons);
+    const auto GENEND = std::chrono::steady_clock::now();
+
+    printf("synthetic tree in %s: theme '%s'%s, %d icons, %d desktop files (generated in %s)\n", root.c_str(), theme.c_str(),
+           theme != "hicolor" ? " inheriting hicolor" : "", options.icons, options.apps,
+           formatNs(std::chrono::duration_cast<std::chrono::nanoseconds>(GENEND - GENSTART).count()).c_str());
+    if (!g_syscalls.available())
+        printf("syscall counting unavailable (raw_syscalls tracepoint needs perf_event_paranoid <= 1 or CAP_PERFMON)\n");
+    printf("\n%-24s %8s %12s %12s %14s\n", "phase", "runs", "p50", "p99", "syscalls/run");
+
+    std::unique_ptr<CIconLookup> lookup;
+    printResult(measure("constructor (cold)", 1, [&](int) { lookup = std::make_unique<CIconLookup>(); }));
+
+    printResult(measure("constructor (snapshot)", options.iterations, [&](int) {
+        lookup.reset();
+        lookup = std::make_unique<CIconLookup>();
+    }));
+
+    printResult(measure("refreshCache", options.iterations, [&](int) { lookup->refreshCache(); }));
+
+    std::mt19937       rng(42);
+    std::vector<int>   hitIndices(options.queries);
+    std::uniform_int_distribution<int> apps(0, options.apps - 1);
+    for (auto& index : hitIndices) {
+        index = apps(rng);
+    }
+
+    size_t found = 0;
+    printResult(measure("findIconPath (hit)", options.queries, [&](int i) { found += lookup->findIconPath(appClass(hitIndices[i]), 48).has_value(); }));
+
+    size_t missed = 0;
+    printResult(measure("findIconPath (miss)", options.queries, [&](int i) { missed += !lookup->findIconPath("no-such-app-" + std::to_string(i), 48).has_value(); }));
+
+    // the same few windows opening over and over, including apps without any icon
+    printResult(measure("findIconPath (repeat)", options.queries, [&](int i) {
+        if (i % 4 == 3)
+            lookup->findIconPath("no-icon-app-" + std::to_string(i % 16), 48);
+        else
+            lookup->findIconPath(appClass(hitIndices[i % 16]), 48);
+    }));
+
+    printf("\n%zu/%d hits resolved, %zu/%d misses unresolved\n", found, options.queries, missed, options.queries);
+
+    lookup.reset();
+    if (options.keep) {
+        printf("kept %s\n", root.c_str());
+    } else {
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+// Headless check of the GPU animation path: renders CIconShader into an offscreen framebuffer
+// through an EGL surfaceless context (Mesa llvmpipe works, LIBGL_ALWAYS_SOFTWARE=1 forces it)
+// and compares opacity and scale against the CPU curves at points across every phase, then
+// draws several instances with different timings in one call.
+
+#include "IconAnimation.hpp"
+#include "IconShader.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr int    SIZE      = 64;
+constexpr int    TOLERANCE = 2; // 8-bit rounding of the blend plus float differences
+
+static bool      initEGL() {
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay) {
+        fprintf(stderr, "eglGetPlatformDisplayEXT unavailable\n");
+        return false;
+    }
+
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        fprintf(stderr, "no surfaceless EGL display (needs EGL_MESA_platform_surfaceless)\n");
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    const EGLint attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+    EGLContext   context   = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "no GLES 3 context (needs EGL_KHR_no_config_context and EGL_KHR_surfaceless_context)\n");
+        return false;
+    }
+
+    return true;
+}
+
+static GLuint createTexture(int width, int height, const std::vector<uint8_t>& pixels) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return texture;
+}
+
+static int alphaAt(int x, int y) {
+    uint8_t pixel[4] = {};
+    glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    return pixel[3];
+}
+
+int main() {
+    if (!initEGL())
+        return 77; // skipped, like meson's convention
+
+    printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    CIconShader shader;
+    if (!shader.compile()) {
+        fprintf(stderr, "shader failed to build: %s\n", shader.error().c_str());
+        return 1;
+    }
+
+    GLuint target = createTexture(SIZE, SIZE, std::vector<uint8_t>(SIZE * SIZE * 4, 0));
+    GLuint fbo    = 0;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "framebuffer incomplete\n");
+        return 1;
+    }
+    glViewport(0, 0, SIZE, SIZE);
+
+    // opaque white icon, so the output alpha is the opacity wherever the quad lands
+    GLuint                       icon = createTexture(16, 16, std::vector<uint8_t>(16 * 16 * 4, 255));
+
+    // unit square to the whole viewport
+    const std::array<float, 9>   PROJECTION = {2, 0, -1, 0, 2, -1, 0, 0, 1};
+
+    // a start far from zero, so precision is tested the way a long-running session would
+    const SIconAnimation         animation = {.start = 1000.0f, .fadeIn = 0.15f, .hold = 0.3f, .fadeOut = 0.4f, .scaleFrom = 0.5f};
+    const std::vector<float>     offsets   = {-0.05f, 0.0f, 0.03f, 0.075f, 0.14f, 0.2f, 0.44f, 0.5f, 0.65f, 0.8f, 0.849f, 0.9f};
+
+    int                          failures = 0;
+    for (float offset : offsets) {
+        const float time = animation.start + offset;
+
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        const SIconInstance instance = {.projection = PROJECTION, .animation = animation};
+        shader.draw(icon, {&instance, 1}, time);
+        glFinish();
+
+        // the quad shrinks around the center, so probe the center and the edge the current scale puts the border at
+        const int   expected = (int)std::lround(animationOpacity(animation, time) * 255.0f);
+        const float scale    = animationScale(animation, time);
+        const int   inside   = (int)std::floor(SIZE / 2.0f * (1.0f - scale)) + 1;
+        const int   outside  = (int)std::ceil(SIZE / 2.0f * (1.0f - scale)) - 2;
+
+        const int   center     = alphaAt(SIZE / 2, SIZE / 2);
+        const int   edgeInside = alphaAt(inside, SIZE / 2);
+        const int   edgeOut    = outside >= 0 ? alphaAt(outside, SIZE / 2) : 0;
+
+        const bool  ok = std::abs(center - expected) <= TOLERANCE && std::abs(edgeInside - expected) <= TOLERANCE && edgeOut == 0;
+        printf("%s t=%+.3fs opacity %3d (cpu %3d) scale %.3f edge %3d outside %3d\n", ok ? "ok  " : "FAIL", offset, center, expected, scale, edgeInside, edgeOut);
+        failures += !ok;
+    }
+
+    // the uv rectangle selects a sub-rectangle, as for atlas entries: left half transparent, right half opaque
+    std::vector<uint8_t> split(16 * 16 * 4, 0);
+    for (int y = 0; y < 16; y++) {
+        std::memset(split.data() + (y * 16 + 8) * 4, 255, 8 * 4);
+    }
+    GLuint half = createTexture(16, 16, split);
+    glClear(GL_COLOR_BUFFER_BIT);
+    const SIconInstance uvInstance = {.projection = PROJECTION, .uvRect = {0.75f, 0, 1, 1}, .animation = animation};
+    shader.draw(half, {&uvInstance, 1}, animation.start + 0.3f);
+    glFinish();
+    const bool uvOk = alphaAt(2, SIZE / 2) == 255 && alphaAt(SIZE - 3, SIZE / 2) == 255;
+    printf("%s uv sub-rectangle\n", uvOk ? "ok  " : "FAIL");
+    failures += !uvOk;
+
+    // a 4x4 grid of quads in a single call, each at its own point of the animation, plus one with CPU-evaluated opacity
+    std::vector<SIconInstance> grid;
+    for (int i = 0; i < 16; i++) {
+        const float x = (i % 4) * 0.5f - 1.0f, y = (i / 4) * 0.5f - 1.0f;
+        grid.push_back({.projection = {0.5f, 0, x, 0, 0.5f, y, 0, 0, 1}, .animation = animation});
+        grid.back().animation.start -= offsets[i % offsets.size()];
+    }
+    grid[15].opacity = 0.25f;
+
+    const float gridTime = animation.start;
+    glClear(GL_COLOR_BUFFER_BIT);
+    shader.draw(icon, grid, gridTime);
+    glFinish();
+
+    bool gridOk = true;
+    for (int i = 0; i < 16; i++) {
+        const float expectedOpacity = grid[i].opacity >= 0.0f ? grid[i].opacity : animationOpacity(grid[i].animation, gridTime);
+        const int   expected        = (int)std::lround(expectedOpacity * 255.0f);
+        const int   cell            = SIZE / 4;
+        const int   actual          = alphaAt((i % 4) * cell + cell / 2, (i / 4) * cell + cell / 2);
+        gridOk &= std::abs(actual - expected) <= TOLERANCE;
+    }
+    printf("%s 16 instances in one draw\n", gridOk ? "ok  " : "FAIL");
+    failures += !gridOk;
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
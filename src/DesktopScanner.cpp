@@ -0,0 +1,287 @@
+#include "DesktopScanner.hpp"
+#include "LookupSnapshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+static std::string_view trim(std::string_view s) {
+    const auto start = s.find_first_not_of(" \t");
+    if (start == std::string_view::npos)
+        return {};
+
+    const auto end = s.find_last_not_of(" \t\n\r");
+    return s.substr(start, end - start + 1);
+}
+
+static std::string toLower(std::string_view s) {
+    std::string out(s.size(), '\0');
+    std::transform(s.begin(), s.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+// programs whose own name says nothing about the app they run
+static constexpr std::array<std::string_view, 12> INTERPRETERS = {"sh", "bash", "python", "python3", "perl", "java", "mono", "wine", "gio", "xdg-open", "gtk-launch", "pkexec"};
+
+static std::string_view baseName(std::string_view path) {
+    const auto slash = path.rfind('/');
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+// last component of a reverse-DNS app ID such as org.gnome.Nautilus, empty for anything else
+static std::string_view appIdSuffix(std::string_view id) {
+    if (std::count(id.begin(), id.end(), '.') < 2)
+        return {};
+    return id.substr(id.rfind('.') + 1);
+}
+
+// Exec= split into arguments; double quotes group but escapes are kept, which is fine for names
+static std::vector<std::string_view> splitExec(std::string_view exec) {
+    std::vector<std::string_view> args;
+    size_t                        pos = 0;
+    while (pos < exec.size()) {
+        if (exec[pos] == ' ') {
+            pos++;
+            continue;
+        }
+
+        if (exec[pos] == '"') {
+            auto end = pos + 1;
+            while (end < exec.size() && exec[end] != '"') {
+                end += exec[end] == '\\' ? 2 : 1;
+            }
+            args.push_back(exec.substr(pos + 1, std::min(end, exec.size()) - pos - 1));
+            pos = end + 1;
+            continue;
+        }
+
+        const auto end = std::min(exec.find(' ', pos), exec.size());
+        args.push_back(exec.substr(pos, end - pos));
+        pos = end;
+    }
+    return args;
+}
+
+// the names a window of this Exec line is likely to carry as its class
+static void execAliases(std::string_view exec, std::vector<std::string>& out) {
+    const auto args = splitExec(exec);
+    size_t     i    = 0;
+
+    // env VAR=value ... program
+    if (i < args.size() && baseName(args[i]) == "env") {
+        for (i++; i < args.size() && (args[i].starts_with('-') || args[i].contains('=')); i++) {}
+    }
+    if (i >= args.size())
+        return;
+
+    const auto program = baseName(args[i]);
+
+    if (program == "flatpak") {
+        // flatpak run [options] ID, where --command= names the binary inside the sandbox
+        for (i++; i < args.size(); i++) {
+            if (args[i].starts_with("--command="))
+                out.emplace_back(baseName(args[i].substr(10)));
+            else if (!args[i].starts_with('-') && args[i] != "run") {
+                out.emplace_back(args[i]);
+                out.emplace_back(appIdSuffix(args[i]));
+                break;
+            }
+        }
+        return;
+    }
+
+    if (program == "steam") {
+        // Steam names game windows steam_app_<id> after the id it launched them with
+        for (const auto& arg : args) {
+            if (!arg.starts_with("steam://rungameid/"))
+                continue;
+            const auto id = arg.substr(18);
+            out.emplace_back("steam_app_" + std::string(id.substr(0, id.find_first_not_of("0123456789"))));
+        }
+        return;
+    }
+
+    if (std::find(INTERPRETERS.begin(), INTERPRETERS.end(), program) != INTERPRETERS.end())
+        return;
+
+    out.emplace_back(program);
+
+    // snap commands are /snap/bin/<snap> or /snap/bin/<snap>.<app>
+    if (args[i].starts_with("/snap/bin/") && program.contains('.'))
+        out.emplace_back(program.substr(0, program.find('.')));
+}
+
+void parseDesktopEntry(std::string_view contents, std::string_view basename, SDesktopFile& out) {
+    std::string_view iconName;
+    std::string_view startupWmClass;
+    std::string_view appName;
+    std::string_view exec;
+    std::string_view flatpakId;
+    std::string_view snapName;
+    bool             inDesktopEntry = false;
+
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        auto end = contents.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = contents.size();
+
+        const auto line = trim(contents.substr(pos, end - pos));
+        pos             = end + 1;
+
+        if (line == "[Desktop Entry]") {
+            inDesktopEntry = true;
+            continue;
+        }
+
+        if (line.starts_with("[")) {
+            // [Desktop Entry] is the first group by spec, nothing after it matters
+            if (inDesktopEntry)
+                break;
+            continue;
+        }
+
+        if (!inDesktopEntry)
+            continue;
+
+        if (line.starts_with("Icon=")) {
+            iconName = line.substr(5);
+        } else if (line.starts_with("StartupWMClass=")) {
+            startupWmClass = line.substr(15);
+        } else if (line.starts_with("Name=") && appName.empty()) {
+            appName = line.substr(5);
+        } else if (line.starts_with("Exec=")) {
+            exec = line.substr(5);
+        } else if (line.starts_with("X-Flatpak=")) {
+            flatpakId = line.substr(10);
+        } else if (line.starts_with("X-SnapInstanceName=")) {
+            snapName = line.substr(19);
+        }
+    }
+
+    if (iconName.empty())
+        return;
+
+    const std::string icon(iconName);
+    const size_t      first = out.entries.size();
+
+    if (!startupWmClass.empty())
+        out.entries.emplace_back(toLower(startupWmClass), icon);
+    if (!appName.empty())
+        out.entries.emplace_back(toLower(appName), icon);
+    out.entries.emplace_back(toLower(basename), icon);
+    out.entries.emplace_back(toLower(iconName), icon);
+
+    std::vector<std::string> aliases;
+    execAliases(exec, aliases);
+    aliases.emplace_back(appIdSuffix(basename));
+    if (!flatpakId.empty()) {
+        aliases.emplace_back(flatpakId);
+        aliases.emplace_back(appIdSuffix(flatpakId));
+    }
+    // snap desktop files are named <snap>_<app>.desktop
+    if (!snapName.empty()) {
+        aliases.emplace_back(snapName);
+        if (basename.starts_with(snapName) && basename.size() > snapName.size() + 1 && basename[snapName.size()] == '_')
+            aliases.emplace_back(basename.substr(snapName.size() + 1));
+    }
+
+    for (const auto& alias : aliases) {
+        auto key = toLower(alias);
+        if (key.empty() || std::any_of(out.entries.begin() + first, out.entries.end(), [&](const auto& entry) { return entry.first == key; }) ||
+            std::any_of(out.aliases.begin(), out.aliases.end(), [&](const auto& entry) { return entry.first == key; }))
+            continue;
+        out.aliases.emplace_back(std::move(key), icon);
+    }
+}
+
+SDesktopFile parseDesktopFile(const std::string& dir, const std::string& name) {
+    SDesktopFile file;
+    file.name = name;
+
+    const std::string path = dir + "/" + name;
+    int               fd   = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return file;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return file;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return file;
+
+    const std::string_view basename(name.data(), name.size() - (name.ends_with(".desktop") ? 8 : 0));
+    parseDesktopEntry(std::string_view((const char*)map, st.st_size), basename, file);
+    munmap(map, st.st_size);
+
+    return file;
+}
+
+std::vector<SDesktopDirectory> scanDesktopDirs(const std::vector<std::string>& dirs) {
+    struct SFile {
+        size_t      dir = 0;
+        std::string name;
+    };
+
+    std::vector<SDesktopDirectory> result(dirs.size());
+    std::vector<SFile>             files;
+
+    for (size_t i = 0; i < dirs.size(); i++) {
+        result[i].path  = dirs[i];
+        result[i].mtime = pathMtime(dirs[i]);
+
+        if (result[i].mtime < 0)
+            continue;
+
+        try {
+            for (const auto& entry : fs::directory_iterator(dirs[i])) {
+                if (entry.path().extension() != ".desktop")
+                    continue;
+                files.push_back({i, entry.path().filename().string()});
+            }
+        } catch (const std::exception& e) {}
+    }
+
+    // one output slot per file, so workers never share state and the merge keeps directory order
+    std::vector<SDesktopFile> perFile(files.size());
+    std::atomic<size_t>       next = 0;
+
+    auto work = [&] {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            perFile[i] = parseDesktopFile(dirs[files[i].dir], files[i].name);
+        }
+    };
+
+    const size_t maxThreads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    const size_t threads    = std::clamp<size_t>(files.size() / 64, 1, maxThreads);
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!perFile[i].entries.empty())
+            result[files[i].dir].files.push_back(std::move(perFile[i]));
+    }
+
+    return result;
+}
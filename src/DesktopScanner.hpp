@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct SDesktopFile {
+    std::string                                      name;
+    std::vector<std::pair<std::string, std::string>> entries; // lowercased key -> icon name, in parse order
+    // keys derived from Exec, flatpak and snap metadata; only consulted when no entry key matches
+    std::vector<std::pair<std::string, std::string>> aliases;
+};
+
+struct SDesktopDirectory {
+    std::string               path;
+    int64_t                   mtime = -1;
+    std::vector<SDesktopFile> files; // only files that provide an icon
+};
+
+// Appends the lookup keys and aliases of one .desktop file. Only the [Desktop Entry] group is looked at.
+void parseDesktopEntry(std::string_view contents, std::string_view basename, SDesktopFile& out);
+
+// mmaps and parses a single .desktop file. Returns an empty record if it's missing or has no icon.
+SDesktopFile parseDesktopFile(const std::string& dir, const std::string& name);
+
+// mmaps and parses every .desktop file of the given directories, fanned out over a few threads.
+// Results are returned in the same order as the input directories.
+std::vector<SDesktopDirectory> scanDesktopDirs(const std::vector<std::string>& dirs);
@@ -0,0 +1,64 @@
+#include "FileWatcher.hpp"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstring>
+
+CFileWatcher::CFileWatcher() {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+CFileWatcher::~CFileWatcher() {
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+int CFileWatcher::add(const std::string& path, uint32_t mask) {
+    if (m_fd < 0)
+        return -1;
+
+    const int wd = inotify_add_watch(m_fd, path.c_str(), mask);
+    if (wd >= 0)
+        m_watches.push_back(wd);
+
+    return wd;
+}
+
+void CFileWatcher::clear() {
+    for (const int wd : m_watches) {
+        inotify_rm_watch(m_fd, wd);
+    }
+    m_watches.clear();
+}
+
+std::vector<CFileWatcher::SEvent> CFileWatcher::readEvents() {
+    std::vector<SEvent> events;
+    if (m_fd < 0)
+        return events;
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (true) {
+        const ssize_t len = read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < len;) {
+            inotify_event event;
+            std::memcpy(&event, buffer + offset, sizeof(event));
+
+            SEvent out;
+            out.wd   = event.wd;
+            out.mask = event.mask;
+            if (event.len > 0) {
+                const char* name = buffer + offset + sizeof(inotify_event);
+                out.name         = std::string(name, strnlen(name, event.len));
+            }
+            events.push_back(std::move(out));
+
+            offset += sizeof(inotify_event) + event.len;
+        }
+    }
+
+    return events;
+}
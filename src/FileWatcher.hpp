@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Thin inotify wrapper. The owner polls fd() from its event loop and calls readEvents() when readable.
+class CFileWatcher {
+  public:
+    struct SEvent {
+        int         wd   = -1;
+        uint32_t    mask = 0;
+        std::string name;
+    };
+
+    CFileWatcher();
+    ~CFileWatcher();
+
+    CFileWatcher(const CFileWatcher&)            = delete;
+    CFileWatcher& operator=(const CFileWatcher&) = delete;
+
+    int                 fd() const { return m_fd; }
+    int                 add(const std::string& path, uint32_t mask);
+    void                clear();
+    std::vector<SEvent> readEvents();
+
+  private:
+    int              m_fd = -1;
+    std::vector<int> m_watches;
+};
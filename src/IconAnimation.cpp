@@ -0,0 +1,39 @@
+#include "IconAnimation.hpp"
+
+static float easeOutCubic(float t) {
+    const float u = 1.0f - t;
+    return 1.0f - u * u * u;
+}
+
+static float easeInCubic(float t) {
+    return t * t * t;
+}
+
+float animationOpacity(const SIconAnimation& animation, float time) {
+    float elapsed = time - animation.start;
+    if (elapsed < 0.0f)
+        return 0.0f;
+
+    if (elapsed < animation.fadeIn)
+        return easeOutCubic(elapsed / animation.fadeIn);
+    elapsed -= animation.fadeIn;
+
+    if (elapsed < animation.hold)
+        return 1.0f;
+    elapsed -= animation.hold;
+
+    if (elapsed < animation.fadeOut)
+        return 1.0f - easeInCubic(elapsed / animation.fadeOut);
+
+    return 0.0f;
+}
+
+float animationScale(const SIconAnimation& animation, float time) {
+    const float elapsed = time - animation.start;
+    if (elapsed < 0.0f)
+        return animation.scaleFrom;
+    if (elapsed >= animation.fadeIn)
+        return 1.0f;
+
+    return animation.scaleFrom + (1.0f - animation.scaleFrom) * easeOutCubic(elapsed / animation.fadeIn);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Timing of one overlay's fade-in, hold and fade-out, in seconds. start is relative to a clock the
+// caller picks, kept close to the present so the values survive float precision on the GPU.
+struct SIconAnimation {
+    float start     = 0.0f;
+    float fadeIn    = 0.15f;
+    float hold      = 0.3f;
+    float fadeOut   = 0.4f;
+    float scaleFrom = 1.0f; // icon scale when the fade-in starts, eased to 1 over the fade-in
+
+    float end() const {
+        return start + fadeIn + hold + fadeOut;
+    }
+};
+
+// The curves on the CPU. The shader in IconShader.cpp evaluates the same ones and has to stay in step.
+float animationOpacity(const SIconAnimation& animation, float time);
+float animationScale(const SIconAnimation& animation, float time);
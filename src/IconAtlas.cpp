@@ -0,0 +1,327 @@
+#include "IconAtlas.hpp"
+#include "StagingPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static GLenum glFormat(ePixelFormat format) {
+    return format == PIXEL_FORMAT_BGRA ? GL_BGRA_EXT : GL_RGBA;
+}
+
+CIconAtlas::~CIconAtlas() {
+    // textures still on screen keep their page alive through their own handle
+    for (auto& slot : m_slots) {
+        if (slot.owner)
+            slot.owner->atlas = nullptr;
+    }
+}
+
+std::shared_ptr<SIconTexture> CIconAtlas::insert(const SIconImage& image, SUploadRegion* region) {
+    if (image.width <= 0 || image.height <= 0 || image.pixels.size() < (size_t)image.width * image.height * 4)
+        return nullptr;
+
+    // one transparent texel around every icon so linear filtering never picks up a neighbour
+    const int paddedWidth  = image.width + 2;
+    const int paddedHeight = image.height + 2;
+    if (paddedWidth > PAGE_SIZE || paddedHeight > PAGE_SIZE)
+        return nullptr;
+
+    auto placement = allocate(m_pages, paddedWidth, paddedHeight);
+    if (!placement && defragment())
+        placement = allocate(m_pages, paddedWidth, paddedHeight);
+    if (!placement)
+        return nullptr;
+
+    uint32_t id = 0;
+    if (!m_freeSlots.empty()) {
+        id = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        id = m_slots.size();
+        m_slots.emplace_back();
+    }
+
+    SSlot& slot = m_slots[id];
+    slot        = {placement->page, placement->x, placement->y, paddedWidth, paddedHeight, nullptr};
+    slot.page->live++;
+    m_liveSlots++;
+
+    const size_t BYTES        = (size_t)paddedWidth * paddedHeight * 4;
+    size_t       bufferOffset = 0;
+    uint8_t*     mapped       = region ? region->take(BYTES, bufferOffset) : nullptr;
+
+    std::vector<uint8_t> padded;
+    if (!mapped)
+        padded = g_stagingPool.acquire(BYTES);
+    uint8_t* staging = mapped ? mapped : padded.data();
+
+    std::memset(staging, 0, BYTES);
+    for (int row = 0; row < image.height; row++) {
+        const uint8_t* src = image.pixels.data() + (size_t)row * image.width * 4;
+        uint8_t*       dst = staging + ((size_t)(row + 1) * paddedWidth + 1) * 4;
+        if (image.format == slot.page->format)
+            std::memcpy(dst, src, (size_t)image.width * 4);
+        else
+            swizzleRedBlue(src, dst, image.width);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, slot.page->texture->m_texID);
+    if (mapped) {
+        // reads from the ring on the GPU's time, the call returns without copying
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, region->buffer);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot.x, slot.y, paddedWidth, paddedHeight, glFormat(slot.page->format), GL_UNSIGNED_BYTE, (const void*)bufferOffset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot.x, slot.y, paddedWidth, paddedHeight, glFormat(slot.page->format), GL_UNSIGNED_BYTE, padded.data());
+        g_stagingPool.release(std::move(padded));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    auto texture    = std::make_shared<SIconTexture>();
+    texture->width  = image.width;
+    texture->height = image.height;
+    texture->bytes  = (size_t)paddedWidth * paddedHeight * 4;
+    texture->atlas  = this;
+    texture->slot   = id;
+    slot.owner      = texture.get();
+    updateOwner(slot);
+
+    return texture;
+}
+
+void CIconAtlas::release(uint32_t id) {
+    if (id >= m_slots.size() || !m_slots[id].page)
+        return;
+
+    SSlot& slot = m_slots[id];
+    SPage* page = slot.page;
+
+    freeOnPage(*page, slot.x, slot.y, slot.width);
+    page->live--;
+
+    slot = {};
+    m_freeSlots.push_back(id);
+    m_liveSlots--;
+    m_compacted = false;
+
+    // keep one page around, the next launch will want it anyway
+    if (page->live == 0 && m_pages.size() > 1)
+        std::erase_if(m_pages, [page](const auto& p) { return p.get() == page; });
+}
+
+std::optional<CIconAtlas::SPlacement> CIconAtlas::allocate(std::vector<std::unique_ptr<SPage>>& pages, int width, int height) {
+    SPlacement placement;
+
+    for (auto& page : pages) {
+        if (allocateOnPage(*page, width, height, placement))
+            return placement;
+    }
+
+    if (pages.size() >= MAX_PAGES)
+        return std::nullopt;
+
+    SPage* page = createPage(pages);
+    if (!page || !allocateOnPage(*page, width, height, placement))
+        return std::nullopt;
+
+    return placement;
+}
+
+bool CIconAtlas::allocateOnPage(SPage& page, int width, int height, SPlacement& out) {
+    // tightest shelf with a free span wide enough; tall shelves are only handed to small icons once empty
+    size_t bestShelf = page.shelves.size();
+    size_t bestSpan  = 0;
+
+    for (size_t i = 0; i < page.shelves.size(); i++) {
+        const auto& shelf = page.shelves[i];
+        const bool  empty = shelf.free.size() == 1 && shelf.free[0].width == PAGE_SIZE;
+
+        if (shelf.height < height || (!empty && shelf.height > height + height / 4))
+            continue;
+        if (bestShelf < page.shelves.size() && page.shelves[bestShelf].height <= shelf.height)
+            continue;
+
+        for (size_t j = 0; j < shelf.free.size(); j++) {
+            if (shelf.free[j].width >= width) {
+                bestShelf = i;
+                bestSpan  = j;
+                break;
+            }
+        }
+    }
+
+    if (bestShelf == page.shelves.size()) {
+        if (page.top + height > PAGE_SIZE)
+            return false;
+
+        // round shelf heights up a little so icons of neighbouring sizes can share them
+        const int shelfHeight = std::min((height + 7) & ~7, PAGE_SIZE - page.top);
+        page.shelves.push_back({page.top, shelfHeight, {{0, PAGE_SIZE}}});
+        page.top += shelfHeight;
+        bestSpan = 0;
+    }
+
+    auto& shelf = page.shelves[bestShelf];
+    auto& span  = shelf.free[bestSpan];
+
+    out = {&page, span.x, shelf.y};
+
+    span.x += width;
+    span.width -= width;
+    if (span.width == 0)
+        shelf.free.erase(shelf.free.begin() + bestSpan);
+
+    return true;
+}
+
+void CIconAtlas::freeOnPage(SPage& page, int x, int y, int width) {
+    auto shelf = std::find_if(page.shelves.begin(), page.shelves.end(), [y](const SShelf& s) { return s.y == y; });
+    if (shelf == page.shelves.end())
+        return;
+
+    auto& free = shelf->free;
+    auto  it   = std::lower_bound(free.begin(), free.end(), x, [](const SSpan& span, int x) { return span.x < x; });
+    it         = free.insert(it, {x, width});
+
+    if (it + 1 != free.end() && it->x + it->width == (it + 1)->x) {
+        it->width += (it + 1)->width;
+        free.erase(it + 1);
+    }
+    if (it != free.begin() && (it - 1)->x + (it - 1)->width == it->x) {
+        (it - 1)->width += it->width;
+        free.erase(it);
+    }
+
+    // give empty shelves at the bottom back to the page so they can be re-cut at another height
+    while (!page.shelves.empty()) {
+        const auto& last = page.shelves.back();
+        if (last.free.size() != 1 || last.free[0].width != PAGE_SIZE)
+            break;
+        page.top -= last.height;
+        page.shelves.pop_back();
+    }
+}
+
+CIconAtlas::SPage* CIconAtlas::createPage(std::vector<std::unique_ptr<SPage>>& pages) {
+    auto page    = std::make_unique<SPage>();
+    page->format = preferredUploadFormat();
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    if (!textureId)
+        return nullptr;
+
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    const GLenum FORMAT = glFormat(page->format);
+    glTexImage2D(GL_TEXTURE_2D, 0, FORMAT, PAGE_SIZE, PAGE_SIZE, 0, FORMAT, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    page->texture          = makeShared<CTexture>();
+    page->texture->m_texID = textureId;
+    page->texture->m_size  = {PAGE_SIZE, PAGE_SIZE};
+
+    pages.push_back(std::move(page));
+    return pages.back().get();
+}
+
+bool CIconAtlas::defragment() {
+    // nothing was freed since the last repack, so it can't do better this time
+    if (m_compacted || m_liveSlots == 0)
+        return false;
+
+    m_compacted = true;
+
+    std::vector<uint32_t> order;
+    for (uint32_t id = 0; id < m_slots.size(); id++) {
+        if (m_slots[id].page)
+            order.push_back(id);
+    }
+
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const auto& A = m_slots[a];
+        const auto& B = m_slots[b];
+        return A.height != B.height ? A.height > B.height : A.width > B.width;
+    });
+
+    std::vector<std::unique_ptr<SPage>> pages;
+    std::vector<SPlacement>             placements(m_slots.size());
+    for (uint32_t id : order) {
+        auto placement = allocate(pages, m_slots[id].width, m_slots[id].height);
+        if (!placement)
+            return false;
+        placements[id] = *placement;
+    }
+
+    GLint prevRead = 0, prevDraw = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevRead);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDraw);
+    const GLboolean SCISSOR = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+
+    GLuint framebuffers[2] = {0, 0};
+    glGenFramebuffers(2, framebuffers);
+
+    bool   ok       = true;
+    SPage* readPage = nullptr;
+    SPage* drawPage = nullptr;
+    for (uint32_t id : order) {
+        const auto& slot   = m_slots[id];
+        const auto& target = placements[id];
+
+        if (slot.page != readPage) {
+            readPage = slot.page;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, readPage->texture->m_texID, 0);
+            ok = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+        if (ok && target.page != drawPage) {
+            drawPage = target.page;
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, drawPage->texture->m_texID, 0);
+            ok = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+        // some drivers can't render to BGRA textures, the caller falls back to a standalone texture then
+        if (!ok)
+            break;
+
+        glBlitFramebuffer(slot.x, slot.y, slot.x + slot.width, slot.y + slot.height, target.x, target.y, target.x + slot.width, target.y + slot.height, GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+    }
+
+    glDeleteFramebuffers(2, framebuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevRead);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDraw);
+    if (SCISSOR)
+        glEnable(GL_SCISSOR_TEST);
+
+    if (!ok)
+        return false;
+
+    for (uint32_t id : order) {
+        auto& slot = m_slots[id];
+        slot.page  = placements[id].page;
+        slot.x     = placements[id].x;
+        slot.y     = placements[id].y;
+        slot.page->live++;
+        updateOwner(slot);
+    }
+
+    m_pages = std::move(pages);
+    return true;
+}
+
+void CIconAtlas::updateOwner(const SSlot& slot) {
+    if (!slot.owner)
+        return;
+
+    slot.owner->texture       = slot.page->texture;
+    slot.owner->uvTopLeft     = {(slot.x + 1) / (double)PAGE_SIZE, (slot.y + 1) / (double)PAGE_SIZE};
+    slot.owner->uvBottomRight = {(slot.x + slot.width - 1) / (double)PAGE_SIZE, (slot.y + slot.height - 1) / (double)PAGE_SIZE};
+}
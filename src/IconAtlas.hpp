@@ -0,0 +1,82 @@
+#pragma once
+
+#include "TextureCache.hpp"
+#include "IconRasterizer.hpp"
+#include "UploadRing.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Packs uploaded icons into a few large GL textures so overlays share one texture and
+// one set of GL state. Each page is split into horizontal shelves; freed slots go back to
+// their shelf and empty shelves/pages are reclaimed. When every page is full the live
+// icons are repacked on the GPU before giving up. Compositor thread only.
+class CIconAtlas {
+  public:
+    CIconAtlas() = default;
+    ~CIconAtlas();
+
+    CIconAtlas(const CIconAtlas&)            = delete;
+    CIconAtlas& operator=(const CIconAtlas&) = delete;
+
+    // nullptr if the icon doesn't fit a page or the atlas is full, callers then fall back to uploadIconTexture.
+    // With a ring region the padded pixels are written into it and uploaded from there.
+    std::shared_ptr<SIconTexture> insert(const SIconImage& image, SUploadRegion* region = nullptr);
+    void                          release(uint32_t slot);
+
+    size_t                        pageCount() const { return m_pages.size(); }
+    size_t                        liveSlots() const { return m_liveSlots; }
+
+    static constexpr int          PAGE_SIZE = 1024;
+    static constexpr size_t       MAX_PAGES = 4;
+
+  private:
+    struct SSpan {
+        int x     = 0;
+        int width = 0;
+    };
+
+    struct SShelf {
+        int                y      = 0;
+        int                height = 0;
+        std::vector<SSpan> free; // sorted by x
+    };
+
+    struct SPage {
+        SP<CTexture>        texture;
+        ePixelFormat        format = PIXEL_FORMAT_BGRA;
+        std::vector<SShelf> shelves;
+        int                 top  = 0; // first row not claimed by a shelf
+        size_t              live = 0;
+    };
+
+    struct SSlot {
+        SPage*        page   = nullptr;
+        int           x      = 0;
+        int           y      = 0;
+        int           width  = 0; // padded
+        int           height = 0; // padded
+        SIconTexture* owner  = nullptr;
+    };
+
+    struct SPlacement {
+        SPage* page = nullptr;
+        int    x    = 0;
+        int    y    = 0;
+    };
+
+    std::optional<SPlacement>           allocate(std::vector<std::unique_ptr<SPage>>& pages, int width, int height);
+    bool                                allocateOnPage(SPage& page, int width, int height, SPlacement& out);
+    void                                freeOnPage(SPage& page, int x, int y, int width);
+    SPage*                              createPage(std::vector<std::unique_ptr<SPage>>& pages);
+    bool                                defragment();
+    void                                updateOwner(const SSlot& slot);
+
+    std::vector<std::unique_ptr<SPage>> m_pages;
+    std::vector<SSlot>                  m_slots;
+    std::vector<uint32_t>               m_freeSlots;
+    size_t                              m_liveSlots = 0;
+    bool                                m_compacted = false;
+};
@@ -0,0 +1,138 @@
+#include "IconCache.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// major, minor, hash offset, directory list offset
+constexpr size_t   HEADER_SIZE = 12;
+// an unreadable offset, and the cache's own marker for empty buckets and chain ends
+constexpr uint32_t INVALID = 0xFFFFFFFF;
+// next, name offset, image list offset
+constexpr size_t   CHAIN_ENTRY_SIZE = 12;
+// directory index, flags, image data offset
+constexpr size_t   IMAGE_SIZE = 8;
+
+// icon_name_hash from GTK, over signed chars like the generator
+static uint32_t iconNameHash(std::string_view name) {
+    uint32_t h = (signed char)name[0];
+    for (size_t i = 1; i < name.size(); i++) {
+        h = (h << 5) - h + (signed char)name[i];
+    }
+    return h;
+}
+
+CIconCache::~CIconCache() {
+    munmap((void*)m_data, m_size);
+}
+
+std::unique_ptr<CIconCache> CIconCache::open(const std::string& themePath) {
+    const auto path = themePath + "/icon-theme.cache";
+    const int  fd   = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st, dirSt;
+    if (fstat(fd, &st) != 0 || stat(themePath.c_str(), &dirSt) != 0 || st.st_mtime < dirSt.st_mtime || (size_t)st.st_size < HEADER_SIZE) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    std::unique_ptr<CIconCache> cache(new CIconCache((const uint8_t*)data, st.st_size));
+    if (!cache->validate())
+        return nullptr;
+
+    return cache;
+}
+
+bool CIconCache::validate() const {
+    if (u16(0) != 1 || u16(2) != 0)
+        return false;
+
+    const uint32_t buckets = u32(u32(4));
+    if (buckets == 0 || buckets == INVALID || (m_size - u32(4) - 4) / 4 < buckets)
+        return false;
+
+    const uint32_t dirs = directoryCount();
+    for (uint32_t i = 0; i < dirs; i++) {
+        if (directory(i).empty())
+            return false;
+    }
+
+    return true;
+}
+
+uint16_t CIconCache::u16(size_t offset) const {
+    if (offset > m_size || m_size - offset < 2)
+        return 0xFFFF;
+
+    return (uint16_t)(m_data[offset] << 8 | m_data[offset + 1]);
+}
+
+uint32_t CIconCache::u32(size_t offset) const {
+    if (offset > m_size || m_size - offset < 4)
+        return INVALID;
+
+    return (uint32_t)m_data[offset] << 24 | (uint32_t)m_data[offset + 1] << 16 | (uint32_t)m_data[offset + 2] << 8 | m_data[offset + 3];
+}
+
+std::string_view CIconCache::string(size_t offset) const {
+    if (offset >= m_size)
+        return {};
+
+    const auto* start = (const char*)m_data + offset;
+    const auto* end   = (const char*)std::memchr(start, '\0', m_size - offset);
+    return end ? std::string_view(start, end - start) : std::string_view();
+}
+
+uint32_t CIconCache::directoryCount() const {
+    const uint32_t list  = u32(8);
+    const uint32_t count = u32(list);
+    if (count == INVALID || (m_size - list - 4) / 4 < count)
+        return 0;
+
+    return count;
+}
+
+std::string_view CIconCache::directory(uint32_t index) const {
+    return string(u32(u32(8) + 4 + (size_t)index * 4));
+}
+
+std::pair<uint32_t, uint32_t> CIconCache::findImages(std::string_view iconName) const {
+    if (iconName.empty())
+        return {0, 0};
+
+    const uint32_t hash    = u32(4);
+    const uint32_t buckets = u32(hash);
+    if (buckets == 0 || buckets == INVALID)
+        return {0, 0};
+
+    uint32_t entry = u32(hash + 4 + (size_t)(iconNameHash(iconName) % buckets) * 4);
+
+    // a damaged chain could loop, no real one is longer than the file has entries
+    for (size_t steps = 0; entry != INVALID && steps < m_size / CHAIN_ENTRY_SIZE; steps++) {
+        if (string(u32((size_t)entry + 4)) == iconName) {
+            const uint32_t list  = u32((size_t)entry + 8);
+            const uint32_t count = u32(list);
+            if (count == INVALID || (m_size - list - 4) / IMAGE_SIZE < count)
+                return {0, 0};
+            return {list, count};
+        }
+
+        entry = u32(entry);
+    }
+
+    return {0, 0};
+}
+
+SIconCacheImage CIconCache::image(uint32_t list, uint32_t index) const {
+    const size_t offset = (size_t)list + 4 + (size_t)index * IMAGE_SIZE;
+    return {u16(offset), u16(offset + 2)};
+}
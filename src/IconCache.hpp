@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+enum eIconCacheFlags : uint16_t {
+    ICON_CACHE_XPM = 1 << 0,
+    ICON_CACHE_SVG = 1 << 1,
+    ICON_CACHE_PNG = 1 << 2,
+};
+
+struct SIconCacheImage {
+    uint16_t directory = 0; // index into the cache's directory list
+    uint16_t flags     = 0; // eIconCacheFlags present in that directory
+};
+
+// Read-only view of a theme's icon-theme.cache, the hash table gtk-update-icon-cache writes.
+// Queries walk the mapped file directly, so nothing is built or copied per theme. Every offset is
+// bounds checked, a damaged cache just answers nothing. Safe to query from any thread.
+class CIconCache {
+  public:
+    ~CIconCache();
+
+    CIconCache(const CIconCache&)            = delete;
+    CIconCache& operator=(const CIconCache&) = delete;
+
+    // nullptr unless the cache exists, has a version we read and is at least as new as the theme
+    // directory, the same staleness check GTK applies
+    static std::unique_ptr<CIconCache> open(const std::string& themePath);
+
+    uint32_t                           directoryCount() const;
+    // relative to the theme root, e.g. "48x48/apps"
+    std::string_view                   directory(uint32_t index) const;
+
+    template <typename F>
+    void forEachImage(std::string_view iconName, F&& fn) const {
+        const auto [list, count] = findImages(iconName);
+        for (uint32_t i = 0; i < count; i++) {
+            fn(image(list, i));
+        }
+    }
+
+  private:
+    CIconCache(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool                          validate() const;
+    uint16_t                      u16(size_t offset) const;
+    uint32_t                      u32(size_t offset) const;
+    std::string_view              string(size_t offset) const;
+    // offset and length of the icon's image list, {0, 0} when it isn't cached
+    std::pair<uint32_t, uint32_t> findImages(std::string_view iconName) const;
+    SIconCacheImage               image(uint32_t list, uint32_t index) const;
+
+    const uint8_t*                m_data = nullptr;
+    size_t                        m_size = 0;
+};
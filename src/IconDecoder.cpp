@@ -0,0 +1,402 @@
+#include "IconDecoder.hpp"
+#include "StagingPool.hpp"
+
+#include <png.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+// larger than any icon, small enough that a corrupt header can't ask for gigabytes
+constexpr uint32_t MAX_SOURCE_SIZE = 16384;
+// interlaced PNGs are buffered whole before resampling, 2048x2048 RGBA is 16 MiB
+constexpr uint32_t MAX_INTERLACED_SIZE = 2048;
+
+// Fits width x height inside size x size keeping the aspect ratio, the long side exactly size.
+static bool targetSize(int width, int height, int size, int& targetWidth, int& targetHeight) {
+    if (width <= 0 || height <= 0 || size <= 0)
+        return false;
+
+    const double scale = std::min((double)size / width, (double)size / height);
+    targetWidth        = width >= height ? size : std::max(1, (int)std::lround(width * scale));
+    targetHeight       = height >= width ? size : std::max(1, (int)std::lround(height * scale));
+    return true;
+}
+
+// Area filter fed premultiplied RGBA source rows top to bottom: every target pixel is the
+// average of the source area it covers, weighted by overlap, so no source pixel is skipped
+// however far the image is reduced. Only one row of each is held at a time.
+class CAreaResampler {
+  public:
+    CAreaResampler(int srcWidth, int srcHeight, SIconImage& target) : m_srcWidth(srcWidth), m_srcHeight(srcHeight), m_target(target) {
+        m_scaleY = (double)target.height / srcHeight;
+
+        // the target columns each source column lands in, and by how much
+        const double SCALEX = (double)target.width / srcWidth;
+        m_tapStart.reserve(srcWidth + 1);
+        for (int x = 0; x < srcWidth; x++) {
+            m_tapStart.push_back(m_taps.size());
+            const double left  = x * SCALEX;
+            const double right = x + 1 == srcWidth ? target.width : (x + 1) * SCALEX;
+            for (int column = (int)left; column < target.width && column < right; column++) {
+                m_taps.push_back({column, (float)(std::min(right, column + 1.0) - std::max(left, (double)column))});
+            }
+        }
+        m_tapStart.push_back(m_taps.size());
+
+        m_columns.resize((size_t)target.width * 4);
+        m_accumulator.resize((size_t)target.width * 4);
+    }
+
+    void addRow(const uint8_t* rgba) {
+        if (m_row >= m_srcHeight)
+            return;
+
+        std::fill(m_columns.begin(), m_columns.end(), 0.0f);
+        for (int x = 0; x < m_srcWidth; x++) {
+            const uint8_t* pixel = rgba + (size_t)x * 4;
+            for (size_t tap = m_tapStart[x]; tap < m_tapStart[x + 1]; tap++) {
+                float*      out    = &m_columns[(size_t)m_taps[tap].column * 4];
+                const float WEIGHT = m_taps[tap].weight;
+                out[0] += pixel[0] * WEIGHT;
+                out[1] += pixel[1] * WEIGHT;
+                out[2] += pixel[2] * WEIGHT;
+                out[3] += pixel[3] * WEIGHT;
+            }
+        }
+
+        const double top    = m_row * m_scaleY;
+        const double bottom = m_row + 1 == m_srcHeight ? m_target.height : (m_row + 1) * m_scaleY;
+        for (int y = (int)top; y < m_target.height && y < bottom; y++) {
+            const float WEIGHT = (float)(std::min(bottom, y + 1.0) - std::max(top, (double)y));
+            for (size_t i = 0; i < m_accumulator.size(); i++) {
+                m_accumulator[i] += m_columns[i] * WEIGHT;
+            }
+            if (bottom >= y + 1.0)
+                finishRow(y);
+        }
+
+        m_row++;
+    }
+
+    bool done() const { return m_row == m_srcHeight; }
+
+  private:
+    struct STap {
+        int   column = 0;
+        float weight = 0.0f;
+    };
+
+    void finishRow(int y) {
+        // straight into the upload layout
+        const bool BGRA    = m_target.format == PIXEL_FORMAT_BGRA;
+        uint8_t*   out     = m_target.pixels.data() + (size_t)y * m_target.width * 4;
+        auto       channel = [](float value) { return (uint8_t)std::clamp((int)std::lround(value), 0, 255); };
+        for (int x = 0; x < m_target.width; x++) {
+            const float* in = &m_accumulator[(size_t)x * 4];
+            out[x * 4 + 0]  = channel(in[BGRA ? 2 : 0]);
+            out[x * 4 + 1]  = channel(in[1]);
+            out[x * 4 + 2]  = channel(in[BGRA ? 0 : 2]);
+            out[x * 4 + 3]  = channel(in[3]);
+        }
+        std::fill(m_accumulator.begin(), m_accumulator.end(), 0.0f);
+    }
+
+    int                 m_srcWidth  = 0;
+    int                 m_srcHeight = 0;
+    int                 m_row       = 0;
+    double              m_scaleY    = 1.0;
+    SIconImage&         m_target;
+    std::vector<STap>   m_taps;
+    std::vector<size_t> m_tapStart;
+    std::vector<float>  m_columns;
+    std::vector<float>  m_accumulator;
+};
+
+static SIconImage createTarget(int width, int height, ePixelFormat format) {
+    SIconImage image;
+    image.width  = width;
+    image.height = height;
+    image.format = format;
+    // every pixel is written by the resampler, so the recycled buffer needs no clearing
+    image.pixels = g_stagingPool.acquire((size_t)width * height * 4);
+    return image;
+}
+
+// corrupt icons are expected in the wild, failing the decode is enough
+static void pngError(png_structp png, png_const_charp) {
+    png_longjmp(png, 1);
+}
+
+static void pngWarning(png_structp, png_const_charp) {}
+
+// libpng reports errors by longjmp, so setjmp only lives in these two, which own nothing with a destructor.
+static bool readPngInfo(png_structp png, png_infop info, uint32_t& width, uint32_t& height, int& passes) {
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_read_info(png, info);
+
+    // 8-bit RGBA whatever the file stores
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_gray_to_rgb(png);
+    png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+    passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    width  = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    return png_get_rowbytes(png, info) == (size_t)width * 4;
+}
+
+static bool readPngRow(png_structp png, uint8_t* row) {
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_read_row(png, row, nullptr);
+    return true;
+}
+
+std::optional<SIconImage> decodePng(const std::string& path, int size, ePixelFormat format) {
+    FILE* file = fopen(path.c_str(), "rbe");
+    if (!file)
+        return std::nullopt;
+
+    png_structp png  = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, &pngError, &pngWarning);
+    png_infop   info = png ? png_create_info_struct(png) : nullptr;
+    auto        cleanup = [&] {
+        if (png)
+            png_destroy_read_struct(&png, info ? &info : nullptr, nullptr);
+        fclose(file);
+    };
+
+    if (!info) {
+        cleanup();
+        return std::nullopt;
+    }
+
+    png_init_io(png, file);
+    png_set_user_limits(png, MAX_SOURCE_SIZE, MAX_SOURCE_SIZE);
+
+    uint32_t width = 0, height = 0;
+    int      passes = 1, targetWidth = 0, targetHeight = 0;
+    if (!readPngInfo(png, info, width, height, passes) || (passes > 1 && (width > MAX_INTERLACED_SIZE || height > MAX_INTERLACED_SIZE)) ||
+        !targetSize(width, height, size, targetWidth, targetHeight)) {
+        cleanup();
+        return std::nullopt;
+    }
+
+    SIconImage     image = createTarget(targetWidth, targetHeight, format);
+    CAreaResampler resampler(width, height, image);
+
+    // Interlaced files only have complete rows after the last pass, so they are read whole.
+    // Everything else streams one row at a time through the resampler.
+    const size_t         ROWBYTES = (size_t)width * 4;
+    std::vector<uint8_t> rows     = g_stagingPool.acquire(passes > 1 ? ROWBYTES * height : ROWBYTES);
+
+    bool                 ok = true;
+    for (int pass = 0; ok && pass < passes; pass++) {
+        for (uint32_t y = 0; ok && y < height; y++) {
+            uint8_t* row = rows.data() + (passes > 1 ? ROWBYTES * y : 0);
+            ok           = readPngRow(png, row);
+            if (ok && passes == 1) {
+                premultiplyAlpha(row, width);
+                resampler.addRow(row);
+            }
+        }
+    }
+
+    for (uint32_t y = 0; ok && passes > 1 && y < height; y++) {
+        uint8_t* row = rows.data() + ROWBYTES * y;
+        premultiplyAlpha(row, width);
+        resampler.addRow(row);
+    }
+
+    g_stagingPool.release(std::move(rows));
+    cleanup();
+
+    if (!ok || !resampler.done()) {
+        g_stagingPool.release(std::move(image.pixels));
+        return std::nullopt;
+    }
+
+    return image;
+}
+
+// The quoted strings of an XPM file, in order, with C comments skipped.
+static std::vector<std::string> xpmStrings(const std::string& text) {
+    std::vector<std::string> strings;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text.compare(i, 2, "/*") == 0) {
+            const size_t end = text.find("*/", i + 2);
+            if (end == std::string::npos)
+                break;
+            i = end + 1;
+        } else if (text[i] == '"') {
+            const size_t end = text.find('"', i + 1);
+            if (end == std::string::npos)
+                break;
+            strings.emplace_back(text, i + 1, end - i - 1);
+            i = end;
+        }
+    }
+    return strings;
+}
+
+// Premultiplied RGBA for an XPM color value: hex, None, or one of the X11 names icons actually use.
+static std::optional<std::array<uint8_t, 4>> xpmColor(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+    if (value == "none" || value == "transparent")
+        return std::array<uint8_t, 4>{0, 0, 0, 0};
+
+    if (value.starts_with('#')) {
+        const std::string hex = value.substr(1);
+        if (hex.empty() || hex.size() % 3 != 0 || hex.find_first_not_of("0123456789abcdef") != std::string::npos)
+            return std::nullopt;
+
+        // the most significant byte of each channel, with #rgb standing for #rrggbb
+        const size_t            digits = hex.size() / 3;
+        std::array<uint8_t, 4>  rgba   = {0, 0, 0, 255};
+        for (size_t c = 0; c < 3; c++) {
+            const std::string channel = hex.substr(c * digits, std::min<size_t>(digits, 2));
+            const int         v       = std::stoi(channel, nullptr, 16);
+            rgba[c]                   = (uint8_t)(digits == 1 ? v * 17 : v);
+        }
+        return rgba;
+    }
+
+    static const std::unordered_map<std::string, std::array<uint8_t, 4>> NAMES = {
+        {"black", {0, 0, 0, 255}},         {"white", {255, 255, 255, 255}},   {"red", {255, 0, 0, 255}},
+        {"green", {0, 255, 0, 255}},       {"blue", {0, 0, 255, 255}},        {"yellow", {255, 255, 0, 255}},
+        {"cyan", {0, 255, 255, 255}},      {"magenta", {255, 0, 255, 255}},   {"gray", {190, 190, 190, 255}},
+        {"grey", {190, 190, 190, 255}},    {"darkgray", {169, 169, 169, 255}}, {"darkgrey", {169, 169, 169, 255}},
+        {"lightgray", {211, 211, 211, 255}}, {"lightgrey", {211, 211, 211, 255}}, {"orange", {255, 165, 0, 255}},
+        {"brown", {165, 42, 42, 255}},     {"navy", {0, 0, 128, 255}},        {"purple", {160, 32, 240, 255}},
+    };
+
+    // names may be written with spaces ("light gray")
+    std::erase(value, ' ');
+    if (auto it = NAMES.find(value); it != NAMES.end())
+        return it->second;
+
+    // grayN / greyN, N in percent
+    for (const char* prefix : {"gray", "grey"}) {
+        if (value.starts_with(prefix) && value.size() > 4 && value.size() <= 7 && value.find_first_not_of("0123456789", 4) == std::string::npos) {
+            const uint8_t level = (uint8_t)std::lround(std::min(100, std::stoi(value.substr(4))) * 2.55);
+            return std::array<uint8_t, 4>{level, level, level, 255};
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<SIconImage> decodeXpm(const std::string& path, int size, ePixelFormat format) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return std::nullopt;
+
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (text.find("XPM") == std::string::npos)
+        return std::nullopt;
+
+    const auto strings = xpmStrings(text);
+    if (strings.empty())
+        return std::nullopt;
+
+    int width = 0, height = 0, colors = 0, cpp = 0;
+    if (sscanf(strings[0].c_str(), "%d %d %d %d", &width, &height, &colors, &cpp) != 4 || width <= 0 || height <= 0 || colors <= 0 || cpp <= 0 ||
+        (uint32_t)width > MAX_SOURCE_SIZE || (uint32_t)height > MAX_SOURCE_SIZE || strings.size() < (size_t)1 + colors + height)
+        return std::nullopt;
+
+    // per context the value is everything up to the next key, so "c light gray" stays one color;
+    // the color (c) context wins over grayscale (g, g4) and mono (m) ones
+    static const std::array<std::string, 4> KEYS = {"c", "g", "g4", "m"};
+    std::unordered_map<std::string, std::array<uint8_t, 4>> palette;
+    for (int i = 0; i < colors; i++) {
+        const std::string& line = strings[1 + i];
+        if (line.size() < (size_t)cpp)
+            return std::nullopt;
+
+        std::vector<std::string> words;
+        size_t                   pos = cpp;
+        while (pos < line.size()) {
+            const size_t start = line.find_first_not_of(" \t", pos);
+            if (start == std::string::npos)
+                break;
+            const size_t end = line.find_first_of(" \t", start);
+            words.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+            pos = end == std::string::npos ? line.size() : end;
+        }
+
+        std::unordered_map<std::string, std::string> values;
+        std::string*                                 current = nullptr;
+        for (const auto& word : words) {
+            if (std::ranges::find(KEYS, word) != KEYS.end() || word == "s") {
+                current = &values[word];
+                continue;
+            }
+            if (current)
+                *current += current->empty() ? word : " " + word;
+        }
+
+        std::array<uint8_t, 4> rgba = {0, 0, 0, 255};
+        for (const auto& key : KEYS) {
+            auto value = values.find(key);
+            if (value == values.end())
+                continue;
+            if (auto color = xpmColor(value->second)) {
+                rgba = *color;
+                break;
+            }
+        }
+        palette[line.substr(0, cpp)] = rgba;
+    }
+
+    int targetWidth = 0, targetHeight = 0;
+    if (!targetSize(width, height, size, targetWidth, targetHeight))
+        return std::nullopt;
+
+    // one or two characters per pixel covers nearly every XPM, those index a table instead of hashing
+    std::vector<std::array<uint8_t, 4>> table;
+    if (cpp <= 2) {
+        table.assign(cpp == 1 ? 256 : 65536, {0, 0, 0, 0});
+        for (const auto& [key, rgba] : palette) {
+            table[cpp == 1 ? (uint8_t)key[0] : ((uint8_t)key[0] << 8 | (uint8_t)key[1])] = rgba;
+        }
+    }
+
+    SIconImage           image = createTarget(targetWidth, targetHeight, format);
+    CAreaResampler       resampler(width, height, image);
+    std::vector<uint8_t> row((size_t)width * 4);
+    std::string          key(cpp, ' ');
+
+    for (int y = 0; y < height; y++) {
+        const std::string& pixels = strings[1 + colors + y];
+        for (int x = 0; x < width; x++) {
+            std::array<uint8_t, 4> rgba = {0, 0, 0, 0};
+            const size_t           at   = (size_t)x * cpp;
+            if (at + cpp <= pixels.size()) {
+                if (cpp <= 2)
+                    rgba = table[cpp == 1 ? (uint8_t)pixels[at] : ((uint8_t)pixels[at] << 8 | (uint8_t)pixels[at + 1])];
+                else {
+                    key.assign(pixels, at, cpp);
+                    if (auto it = palette.find(key); it != palette.end())
+                        rgba = it->second;
+                }
+            }
+            std::memcpy(row.data() + (size_t)x * 4, rgba.data(), 4);
+        }
+        resampler.addRow(row.data());
+    }
+
+    return image;
+}
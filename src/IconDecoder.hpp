@@ -0,0 +1,12 @@
+#pragma once
+
+#include "IconRasterizer.hpp"
+
+#include <optional>
+#include <string>
+
+// Bitmap decoders that never hold the full-size image: rows are area-filtered into a staging
+// buffer at the size the icon is drawn at, already premultiplied and in the requested layout.
+// The result fits inside size x size with the source's aspect ratio, like the SVG path.
+std::optional<SIconImage> decodePng(const std::string& path, int size, ePixelFormat format);
+std::optional<SIconImage> decodeXpm(const std::string& path, int size, ePixelFormat format);
@@ -0,0 +1,65 @@
+#include "IconLoader.hpp"
+#include "globals.hpp"
+
+#include <hyprland/src/Compositor.hpp>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+CIconLoader::CIconLoader(size_t threads) : m_pool(threads) {
+    m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_eventFd >= 0)
+        m_source = wl_event_loop_add_fd(g_pCompositor->m_wlEventLoop, m_eventFd, WL_EVENT_READABLE, &CIconLoader::onEventFd, this);
+}
+
+CIconLoader::~CIconLoader() {
+    if (m_source)
+        wl_event_source_remove(m_source);
+
+    int fd = -1;
+    {
+        std::lock_guard lock(m_mutex);
+        std::swap(fd, m_eventFd);
+    }
+
+    if (fd >= 0)
+        close(fd);
+}
+
+void CIconLoader::submit(std::function<Completion()> work) {
+    m_pool.submit([this, work = std::move(work)] {
+        auto completion = work();
+        if (completion)
+            post(std::move(completion));
+    });
+}
+
+void CIconLoader::post(Completion completion) {
+    std::lock_guard lock(m_mutex);
+    m_completions.push_back(std::move(completion));
+
+    if (m_eventFd >= 0) {
+        uint64_t one = 1;
+        (void)!write(m_eventFd, &one, sizeof(one));
+    }
+}
+
+int CIconLoader::onEventFd(int fd, uint32_t mask, void* data) {
+    uint64_t count = 0;
+    (void)!read(fd, &count, sizeof(count));
+
+    static_cast<CIconLoader*>(data)->drain();
+    return 0;
+}
+
+void CIconLoader::drain() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard lock(m_mutex);
+        completions.swap(m_completions);
+    }
+
+    for (auto& completion : completions) {
+        completion();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "WorkerPool.hpp"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct wl_event_source;
+
+// Runs icon work on a worker pool and hands results back to the compositor thread
+// through an eventfd registered on Hyprland's event loop.
+class CIconLoader {
+  public:
+    using Completion = std::function<void()>;
+
+    explicit CIconLoader(size_t threads);
+    ~CIconLoader();
+
+    // work runs on a worker thread; the completion it returns runs on the compositor thread
+    void submit(std::function<Completion()> work);
+
+  private:
+    static int              onEventFd(int fd, uint32_t mask, void* data);
+    void                    post(Completion completion);
+    void                    drain();
+
+    int                     m_eventFd = -1;
+    wl_event_source*        m_source  = nullptr;
+    std::mutex              m_mutex;
+    std::vector<Completion> m_completions;
+
+    // declared last so workers are joined before the queue they post to goes away
+    CWorkerPool m_pool;
+};
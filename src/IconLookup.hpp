@@ -1,29 +1,122 @@
 #pragma once
 
+#include "IconThemeIndex.hpp"
+#include "LookupSnapshot.hpp"
+#include "DesktopScanner.hpp"
+#include "FileWatcher.hpp"
+#include "ProcessResolver.hpp"
+
 #include <string>
 #include <optional>
 #include <vector>
 #include <unordered_map>
 #include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+
+struct SLookupStats {
+    std::string              iconTheme;
+    std::vector<std::string> themePaths;
+    size_t                   desktopKeys      = 0;
+    size_t                   desktopAliases   = 0;
+    size_t                   desktopBytes     = 0; // approximate heap use of both key maps
+    size_t                   themeDirectories = 0;
+    size_t                   themeIcons       = 0; // indexed by scanning, cached themes aren't counted
+    size_t                   cachedThemes     = 0; // theme roots answered from icon-theme.cache
+    size_t                   memoEntries      = 0;
+    size_t                   processCache     = 0; // executables whose names are cached
+    uint64_t                 hits             = 0;
+    uint64_t                 misses           = 0;
+    uint64_t                 negativeHits     = 0; // misses answered from the memo
+    uint64_t                 processHits      = 0; // hits only found through the window's process
+    std::chrono::system_clock::time_point lastRefresh;
+    std::chrono::microseconds             lastRefreshDuration{0};
+};
 
 class CIconLookup {
   public:
     CIconLookup();
     ~CIconLookup() = default;
 
-    std::optional<std::string> findIconPath(const std::string& appClass, int size = 128);
+    // safe to call from worker threads; size is in logical pixels, scale the output's buffer scale.
+    // When the class finds nothing, the window's process (if pid is set) is asked what it runs.
+    // iconName, when given, receives the icon the launch resolves to before any theme lookup: the
+    // Icon= of the desktop entry matched through the class or the process, else the class itself.
+    // Every alias of one app gives the same name. findIconByName() takes it back to a file.
+    std::optional<std::string> findIconPath(const std::string& appClass, int size = 128, int scale = 1, pid_t pid = 0, std::string* iconName = nullptr);
+    std::optional<std::string> findIconByName(const std::string& iconName, int size = 128, int scale = 1);
 
     void refreshCache();
 
+    SLookupStats stats();
+
+    // inotify fd covering the applications dirs, icon theme dirs and theme settings;
+    // call dispatchWatchEvents() from the owning event loop whenever it becomes readable
+    int  watchFd() const;
+    void dispatchWatchEvents();
+
   private:
-    void parseDesktopFiles();
-    std::optional<std::string> searchIconInTheme(const std::string& iconName, int size);
-    std::optional<std::string> searchIconInHicolor(const std::string& iconName, int size);
+    enum eWatchKind : uint8_t {
+        WATCH_DESKTOP_DIR    = 1 << 0,
+        WATCH_ICON_DIR       = 1 << 1,
+        WATCH_ICON_BASE      = 1 << 2,
+        WATCH_THEME_SOURCE   = 1 << 3,
+        WATCH_DESKTOP_PARENT = 1 << 4, // nearest existing ancestor of an applications dir that doesn't exist yet
+    };
+
+    struct SWatch {
+        std::string path;
+        uint8_t     kinds       = 0;
+        size_t      desktopSlot = 0;
+    };
+
+    void registerWatches();
+    void onDesktopFileChanged(size_t slot, const std::string& name);
+    void onDesktopDirsAppeared();
+    void recomputeKey(const std::string& key, bool alias);
+    void loadSnapshot();
+    void noteRefresh(std::chrono::steady_clock::time_point start);
+    void saveSnapshot();
+    bool importThemeName(CSnapshotReader& reader);
+    bool parseDesktopFiles(CSnapshotReader* snapshot = nullptr);
+    void mergeDesktopDirs();
+    std::vector<std::string> getDesktopDirs();
+    std::vector<std::string> getThemeSourceFiles();
+    std::optional<std::string> searchIconInTheme(const std::string& iconName, int size, int scale);
     std::optional<std::string> searchIconInPixmaps(const std::string& iconName);
     std::string getCurrentIconTheme();
     std::vector<std::string> getIconThemePaths();
+    bool rebuildThemeIndex(CSnapshotReader* snapshot = nullptr);
+    std::optional<std::string> resolveIconPath(const std::string& lowerClass, int size, int scale);
+    std::optional<std::string> resolveIconName(const std::string& iconName, int size, int scale);
+    std::optional<std::string> memoizedResolve(const std::string& key, int size, int scale, bool* memoized = nullptr);
+    const std::string* matchDesktopEntry(const std::string& lowerClass) const;
 
     std::unordered_map<std::string, std::string> m_appToIcon;
+    std::unordered_map<std::string, std::string> m_aliasToIcon;
+    std::vector<SDesktopDirectory> m_desktopDirs;
     std::string m_iconTheme;
     std::vector<std::string> m_themePaths;
+    CIconThemeIndex m_themeIndex;
+    std::shared_mutex m_mutex;
+
+    // resolved paths and definite misses keyed by "size@scale:class", process keys included; bumping
+    // m_generation (under the unique lock, whenever desktop or theme data changes) invalidates all of them
+    static constexpr size_t MAX_MEMO_ENTRIES = 1024;
+    uint64_t m_generation = 0;
+    std::mutex m_memoMutex;
+    uint64_t m_memoGeneration = 0;
+    std::unordered_map<std::string, std::optional<std::string>> m_memo;
+    CFileWatcher m_watcher;
+    std::unordered_map<int, SWatch> m_watches;
+    CProcessResolver m_processResolver;
+
+    std::atomic<uint64_t> m_hits = 0;
+    std::atomic<uint64_t> m_misses = 0;
+    std::atomic<uint64_t> m_negativeHits = 0;
+    std::atomic<uint64_t> m_processHits = 0;
+    std::chrono::system_clock::time_point m_lastRefresh;
+    std::chrono::microseconds m_lastRefreshDuration{0};
 };
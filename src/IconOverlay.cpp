@@ -1,272 +1,896 @@
 #include "IconOverlay.hpp"
 #include "IconPassElement.hpp"
+#include "IconRasterizer.hpp"
+#include "StagingPool.hpp"
 #include "globals.hpp"
 
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/render/Renderer.hpp>
 #include <hyprland/src/render/OpenGL.hpp>
+#include <hyprland/src/helpers/math/Math.hpp>
+#include <hyprland/src/debug/Log.hpp>
 
 #include <cmath>
 #include <algorithm>
 #include <vector>
 
-static float easeOutCubic(float t) {
-    return 1.0f - std::pow(1.0f - t, 3.0f);
+// icon_size is logical, so textures are rasterized at the output's scale to stay sharp on HiDPI
+static STextureKey textureKey(const std::string& path, int iconSize, float scale) {
+    return {path, (int)std::lround(iconSize * scale)};
 }
 
-static float easeInCubic(float t) {
-    return t * t * t;
+// One pyramid rasterized for the densest output serves every output from its mip levels.
+static float maxOutputScale() {
+    float scale = 0.0f;
+    for (auto& monitor : g_pCompositor->m_monitors) {
+        if (monitor->m_enabled)
+            scale = std::max(scale, monitor->m_scale);
+    }
+    return scale > 0.0f ? scale : 1.0f;
+}
+
+// themes only ship integer scales, rounding up picks assets at least as large as needed
+static int lookupScale(float scale) {
+    return std::max(1, (int)std::ceil(scale));
 }
 
-CIconOverlay::CIconOverlay(const std::string& appClass, PHLMONITOR monitor) : m_monitor(monitor), m_appClass(appClass) {
+CIconOverlay::CIconOverlay(const std::string& appClass, PHLMONITOR monitor, pid_t pid) : m_monitor(monitor), m_appClass(appClass), m_pid(pid) {
     m_startTime = std::chrono::steady_clock::now();
+    m_trace.mark(TRACE_LAUNCH);
     if (g_pGlobalState) {
         m_iconSize        = g_pGlobalState->iconSize;
         m_fadeInDuration  = g_pGlobalState->fadeInMs;
         m_holdDuration    = g_pGlobalState->holdMs;
         m_fadeOutDuration = g_pGlobalState->fadeOutMs;
-    }
-
-    if (g_pGlobalState && g_pGlobalState->iconLookup) {
-        auto iconPath = g_pGlobalState->iconLookup->findIconPath(appClass, m_iconSize);
-        if (iconPath) {
-            loadIcon(*iconPath);
-        }
+        m_loadDeadline    = g_pGlobalState->loadDeadlineMs;
+        m_scaleIn         = g_pGlobalState->scaleIn;
     }
 }
 
 CIconOverlay::~CIconOverlay() {
-    if (m_hasTexture && m_textureId != 0) {
-        glDeleteTextures(1, &m_textureId);
-    }
+    // never got to show its icon: no icon, too slow, or the output went away
+    if (!m_traced && m_trace.ns[TRACE_LAUNCH])
+        g_launchTracer.recordCancelled();
 }
 
-bool CIconOverlay::loadIcon(const std::string& iconPath) {
-    std::string ext = iconPath.substr(iconPath.find_last_of('.') + 1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+bool CIconOverlay::setTexture(std::shared_ptr<SIconTexture> texture) {
+    if (m_state != ANIM_LOADING || !texture)
+        return false;
 
-    if (ext == "svg") {
-        return loadSvgIcon(iconPath);
-    } else if (ext == "png") {
-        return loadPngIcon(iconPath);
-    } else if (ext == "xpm") {
+    auto now     = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_startTime).count();
+    if (elapsed > m_loadDeadline) {
+        m_state = ANIM_DONE;
         return false;
     }
 
-    return false;
+    m_texture   = std::move(texture);
+    m_state     = ANIM_FADE_IN;
+    m_startTime = now;
+    return true;
 }
 
-bool CIconOverlay::loadSvgIcon(const std::string& path) {
-    GError*    error  = nullptr;
-    RsvgHandle* handle = rsvg_handle_new_from_file(path.c_str(), &error);
+void CIconOverlay::cancel() {
+    m_state = ANIM_DONE;
+}
 
-    if (!handle) {
-        if (error) {
-            g_error_free(error);
-        }
+bool CIconOverlay::update(std::chrono::steady_clock::time_point now) {
+    const float elapsed = std::chrono::duration<float>(now - m_startTime).count();
+
+    if (m_state == ANIM_LOADING) {
+        // launch is skipped if the icon isn't ready in time
+        if (elapsed * 1000.0f > m_loadDeadline)
+            m_state = ANIM_DONE;
+        return m_state != ANIM_DONE;
+    }
+
+    if (m_state == ANIM_DONE)
+        return false;
+
+    const auto animation = this->animation(m_startTime);
+    if (elapsed >= animation.end()) {
+        m_opacity = 0.0f;
+        m_state   = ANIM_DONE;
         return false;
     }
 
-    gdouble width, height;
-    rsvg_handle_get_intrinsic_size_in_pixels(handle, &width, &height);
+    m_state = elapsed < animation.fadeIn ? ANIM_FADE_IN : elapsed < animation.fadeIn + animation.hold ? ANIM_HOLD : ANIM_FADE_OUT;
 
-    if (width <= 0 || height <= 0) {
-        width  = m_iconSize;
-        height = m_iconSize;
+    // the shader evaluates the curves itself, only the end has to be known here
+    const bool GPU = g_pGlobalState && g_pGlobalState->overlayManager && g_pGlobalState->overlayManager->shaderAnimation();
+    if (!GPU) {
+        m_opacity = animationOpacity(animation, elapsed);
+        m_scale   = animationScale(animation, elapsed);
     }
 
-    double scale = std::min((double)m_iconSize / width, (double)m_iconSize / height);
-    int    renderWidth  = (int)(width * scale);
-    int    renderHeight = (int)(height * scale);
+    return true;
+}
 
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, renderWidth, renderHeight);
-    cairo_t*         cr      = cairo_create(surface);
+// the overlay's timing, with the fade-in start measured from epoch
+SIconAnimation CIconOverlay::animation(std::chrono::steady_clock::time_point epoch) const {
+    return {
+        .start     = std::chrono::duration<float>(m_startTime - epoch).count(),
+        .fadeIn    = std::max(0, m_fadeInDuration) / 1000.0f,
+        .hold      = std::max(0, m_holdDuration) / 1000.0f,
+        .fadeOut   = std::max(0, m_fadeOutDuration) / 1000.0f,
+        .scaleFrom = m_scaleIn,
+    };
+}
 
-    cairo_set_source_rgba(cr, 0, 0, 0, 0);
-    cairo_paint(cr);
+float CIconOverlay::getOpacity() const {
+    return m_opacity;
+}
 
-    cairo_scale(cr, scale, scale);
+bool CIconOverlay::isDone() const {
+    return m_state == ANIM_DONE;
+}
 
-    RsvgRectangle viewport = {0, 0, width, height};
-    rsvg_handle_render_document(handle, cr, &viewport, nullptr);
+bool CIconOverlay::setSlot(const Vector2D& offset) {
+    if (offset == m_slot)
+        return false;
 
-    cairo_destroy(cr);
-    g_object_unref(handle);
+    m_slot = offset;
+    return true;
+}
+
+// monitor-local, in pixels, as handed to the renderer
+CBox CIconOverlay::pixelBox() const {
+    if (!m_texture || !m_monitor)
+        return {};
+
+    // the texture may be rasterized for a denser output, the size on this one follows its own scale
+    const double width  = std::round(m_iconSize * m_monitor->m_scale);
+    const double height = std::round(width * m_texture->height / std::max(1, m_texture->width));
 
-    bool result = createTextureFromSurface(surface);
-    cairo_surface_destroy(surface);
+    const auto&  monBox  = m_monitor->m_transformedSize;
+    double       centerX = (monBox.x - width) / 2.0;
+    double       centerY = (monBox.y - height) / 2.0;
 
-    return result;
+    return {centerX + m_slot.x, centerY + m_slot.y, width, height};
 }
 
-bool CIconOverlay::loadPngIcon(const std::string& path) {
-    cairo_surface_t* surface = cairo_image_surface_create_from_png(path.c_str());
+// everything the quad can cover, scale_in above 1 starts it larger than its box
+CBox CIconOverlay::drawBox() const {
+    return pixelBox().scaleFromCenter(std::max(1.0f, m_scaleIn));
+}
 
-    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
-        cairo_surface_destroy(surface);
-        return false;
+// global layout coordinates, as expected by damageBox
+CBox CIconOverlay::logicalBox() const {
+    if (!m_texture || !m_monitor)
+        return {};
+
+    CBox box = drawBox().scale(1.0 / m_monitor->m_scale);
+    box.translate(m_monitor->m_position);
+    // fractional scales round outwards when the renderer converts back to pixels
+    return box.expand(1).round();
+}
+
+void CIconOverlay::damage() const {
+    if (!m_texture || !m_monitor)
+        return;
+
+    CBox box = logicalBox();
+    g_pHyprRenderer->damageBox(box);
+}
+
+void CIconOverlay::markDrawn() {
+    if (m_traced)
+        return;
+
+    m_traced = true;
+    m_trace.mark(TRACE_FIRST_FRAME);
+    g_launchTracer.record(m_trace, m_appClass);
+}
+
+// This overlay as one quad of the batched draw. Returns the texture it samples, 0 when there is nothing to draw.
+GLuint CIconOverlay::instance(std::chrono::steady_clock::time_point epoch, bool shaderAnimation, SIconInstance& out) const {
+    if (!isVisible() || (!shaderAnimation && m_opacity <= 0.0f))
+        return 0;
+
+    const CBox   box       = pixelBox();
+    const auto&  level     = m_texture->level(box.w);
+    const auto   TRANSFORM = wlTransformToHyprutils(invertTransform(m_monitor->m_transform));
+    const Mat3x3 matrix =
+        g_pHyprOpenGL->m_renderData.projection.copy().multiply(g_pHyprOpenGL->m_renderData.monitorProjection.projectBox(box, TRANSFORM, box.rot));
+
+    out.projection = matrix.getMatrix();
+    out.uvRect     = {(float)level.uvTopLeft.x, (float)level.uvTopLeft.y, (float)level.uvBottomRight.x, (float)level.uvBottomRight.y};
+    out.animation  = animation(epoch);
+    if (!shaderAnimation) {
+        out.opacity             = m_opacity;
+        out.animation.scaleFrom = m_scale;
     }
 
-    int srcWidth  = cairo_image_surface_get_width(surface);
-    int srcHeight = cairo_image_surface_get_height(surface);
+    return level.texture->m_texID;
+}
 
-    if (srcWidth != m_iconSize || srcHeight != m_iconSize) {
-        double scale = std::min((double)m_iconSize / srcWidth, (double)m_iconSize / srcHeight);
-        int    newWidth  = (int)(srcWidth * scale);
-        int    newHeight = (int)(srcHeight * scale);
+// one renderTexture per overlay, for drivers that rejected the shader
+void CIconOverlay::renderDirect() {
+    if (!isVisible() || m_opacity <= 0.0f)
+        return;
 
-        cairo_surface_t* scaledSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, newWidth, newHeight);
-        cairo_t*         cr            = cairo_create(scaledSurface);
+    markDrawn();
 
-        cairo_scale(cr, scale, scale);
-        cairo_set_source_surface(cr, surface, 0, 0);
-        cairo_paint(cr);
+    CBox        box   = pixelBox();
+    const auto& level = m_texture->level(box.w);
+    box.scaleFromCenter(m_scale);
 
-        cairo_destroy(cr);
-        cairo_surface_destroy(surface);
-        surface = scaledSurface;
+    // atlas entries only sample their own sub-rectangle of the page
+    const bool SUBRECT = level.uvTopLeft != Vector2D{0, 0} || level.uvBottomRight != Vector2D{1, 1};
+    if (SUBRECT) {
+        g_pHyprOpenGL->m_renderData.primarySurfaceUVTopLeft     = level.uvTopLeft;
+        g_pHyprOpenGL->m_renderData.primarySurfaceUVBottomRight = level.uvBottomRight;
     }
 
-    bool result = createTextureFromSurface(surface);
-    cairo_surface_destroy(surface);
+    g_pHyprOpenGL->renderTexture(level.texture, box, {.a = m_opacity});
 
-    return result;
+    if (SUBRECT) {
+        g_pHyprOpenGL->m_renderData.primarySurfaceUVTopLeft     = Vector2D(-1, -1);
+        g_pHyprOpenGL->m_renderData.primarySurfaceUVBottomRight = Vector2D(-1, -1);
+    }
 }
 
-bool CIconOverlay::createTextureFromSurface(cairo_surface_t* surface) {
-    cairo_surface_flush(surface);
+CIconOverlayManager::~CIconOverlayManager() {
+    if (m_shader.ready() || m_uploadRingTried) {
+        g_pHyprRenderer->makeEGLCurrent();
+        m_shader.destroy();
+        m_uploadRing.destroy();
+    }
+    if (m_prewarmIdle)
+        wl_event_source_remove(m_prewarmIdle);
+    if (m_prewarmTimer)
+        wl_event_source_remove(m_prewarmTimer);
+    if (m_admissionTimer)
+        wl_event_source_remove(m_admissionTimer);
+    if (m_deadlineTimer)
+        wl_event_source_remove(m_deadlineTimer);
+}
 
-    m_textureWidth  = cairo_image_surface_get_width(surface);
-    m_textureHeight = cairo_image_surface_get_height(surface);
-    unsigned char* data = cairo_image_surface_get_data(surface);
+SOverlayStats CIconOverlayManager::stats() const {
+    SOverlayStats stats;
+    stats.overlays = m_overlays.size();
+
+    // overlays of the same app share one texture
+    std::unordered_set<const SIconTexture*> textures;
+    for (const auto& overlay : m_overlays) {
+        if (overlay->isLoading())
+            stats.loading++;
+        if (overlay->texture() && textures.insert(overlay->texture()).second)
+            stats.overlayBytes += overlay->texture()->bytes;
+    }
+    stats.overlayTextures = textures.size();
+
+    stats.cachedTextures  = m_textureCache.size();
+    stats.cachedBytes     = m_textureCache.bytesUsed();
+    stats.atlasPages      = m_atlas.pageCount();
+    stats.atlasBytes      = m_atlas.pageCount() * CIconAtlas::PAGE_SIZE * CIconAtlas::PAGE_SIZE * 4;
+    stats.atlasIcons      = m_atlas.liveSlots();
+    stats.uploadsInFlight = m_uploadsInFlight.size();
+    stats.uploadRingBytes = m_uploadRing.capacity();
+    stats.queuedLaunches  = m_admission.queued();
+    stats.admission       = m_admission.stats();
+    return stats;
+}
 
-    if (!data || m_textureWidth <= 0 || m_textureHeight <= 0) {
+bool CIconOverlayManager::requestLaunch(const std::string& appClass, PHLMONITOR monitor, pid_t pid) {
+    if (!monitor)
         return false;
+
+    const bool ACCEPTED = m_admission.offer({.appClass = appClass, .monitorId = monitor->m_id, .pid = pid, .time = std::chrono::steady_clock::now()});
+    if (ACCEPTED)
+        pumpAdmission();
+    return ACCEPTED;
+}
+
+int CIconOverlayManager::onAdmissionTimer(void* data) {
+    static_cast<CIconOverlayManager*>(data)->pumpAdmission();
+    return 0;
+}
+
+// Starts whatever admission control lets through now, and wakes up again when the token bucket
+// allows the next one. Overlays finishing pump it from onPreRender and dropFinished.
+void CIconOverlayManager::pumpAdmission() {
+    const auto NOW = std::chrono::steady_clock::now();
+
+    for (auto& request : m_admission.admit(NOW, m_overlays.size())) {
+        auto monitor = g_pCompositor->getMonitorFromID(request.monitorId);
+        if (!monitor || !monitor->m_enabled)
+            continue;
+
+        addOverlay(std::make_shared<CIconOverlay>(request.appClass, monitor, request.pid));
     }
 
-    glGenTextures(1, &m_textureId);
-    glBindTexture(GL_TEXTURE_2D, m_textureId);
+    const auto NEXT = m_admission.nextAdmission(NOW, m_overlays.size());
+    if (!NEXT)
+        return;
+
+    if (!m_admissionTimer)
+        m_admissionTimer = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &CIconOverlayManager::onAdmissionTimer, this);
+    if (m_admissionTimer)
+        wl_event_source_timer_update(m_admissionTimer, std::max<int>(1, std::chrono::ceil<std::chrono::milliseconds>(*NEXT).count()));
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+void CIconOverlayManager::addOverlay(std::shared_ptr<CIconOverlay> overlay) {
+    // animation times are floats on the GPU, so the clock restarts whenever nothing is on screen
+    if (m_overlays.empty())
+        m_animationEpoch = std::chrono::steady_clock::now();
+    m_overlays.push_back(overlay);
 
-    std::vector<unsigned char> rgbaData(m_textureWidth * m_textureHeight * 4);
-    for (int i = 0; i < m_textureWidth * m_textureHeight; i++) {
-        rgbaData[i * 4 + 0] = data[i * 4 + 2];
-        rgbaData[i * 4 + 1] = data[i * 4 + 1];
-        rgbaData[i * 4 + 2] = data[i * 4 + 0];
-        rgbaData[i * 4 + 3] = data[i * 4 + 3];
+    if (!g_pGlobalState || !g_pGlobalState->iconLoader || !g_pGlobalState->iconLookup) {
+        overlay->cancel();
+        dropFinished();
+        return;
     }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_textureWidth, m_textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgbaData.data());
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    scheduleDeadline();
+
+    auto*                       lookup   = g_pGlobalState->iconLookup.get();
+    std::weak_ptr<CIconOverlay> weak     = overlay;
+    const std::string           appClass = overlay->getAppClass();
+    const pid_t                 pid      = overlay->getPid();
+    const int                   size     = overlay->getIconSize();
+    const int                   scale    = lookupScale(maxOutputScale());
+
+    g_pGlobalState->iconLoader->submit([this, lookup, weak, appClass, pid, size, scale]() -> CIconLoader::Completion {
+        SLaunchTrace trace;
+        trace.mark(TRACE_RESOLVE_START);
+        std::string iconName;
+        auto        path = lookup->findIconPath(appClass, size, scale, pid, &iconName);
+        trace.mark(TRACE_RESOLVE_END);
+        return [this, weak, path, trace, iconName] {
+            if (m_onLaunchResolved)
+                m_onLaunchResolved(iconName);
+            onIconResolved(weak, path, trace);
+        };
+    });
+}
 
-    m_hasTexture = true;
-    return true;
+void CIconOverlayManager::onIconResolved(std::weak_ptr<CIconOverlay> weak, std::optional<std::string> path, const SLaunchTrace& trace) {
+    auto overlay = weak.lock();
+    if (!overlay || overlay->isDone())
+        return;
+
+    overlay->trace().merge(trace);
+
+    if (!path) {
+        overlay->cancel();
+        dropFinished();
+        return;
+    }
+
+    const STextureKey key = textureKey(*path, overlay->getIconSize(), maxOutputScale());
+
+    if (auto texture = m_textureCache.get(key)) {
+        if (!joinUpload(texture, overlay))
+            showOverlay(overlay, texture);
+        return;
+    }
+
+    // another overlay is already waiting on the same rasterization
+    auto& waiters = m_pendingRasters[key];
+    waiters.push_back(overlay);
+    if (waiters.size() > 1)
+        return;
+
+    if (m_prewarmKeys.contains(key)) {
+        // warmed up already and only waiting for an idle slice to upload, don't make the launch wait for it
+        auto parked = std::find_if(m_prewarmImages.begin(), m_prewarmImages.end(), [&key](const auto& p) { return p.first == key; });
+        if (parked != m_prewarmImages.end()) {
+            auto image = std::move(parked->second);
+            m_prewarmImages.erase(parked);
+            m_prewarmKeys.erase(key);
+            finishRaster(key, std::move(image));
+        }
+        return;
+    }
+
+    g_pGlobalState->iconLoader->submit([this, key]() -> CIconLoader::Completion {
+        SLaunchTrace trace;
+        auto         image = rasterizeIcon(key.path, key.pixelSize, preferredUploadFormat(), &trace);
+        return [this, key, image = std::move(image), trace]() mutable { onIconRasterized(key, std::move(image), trace); };
+    });
 }
 
-bool CIconOverlay::update() {
-    auto now     = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_startTime).count();
+void CIconOverlayManager::onIconRasterized(const STextureKey& key, std::optional<SIconImage> image, SLaunchTrace trace) {
+    if (m_prewarmKeys.contains(key)) {
+        m_prewarmInFlight--;
+        schedulePrewarm(false);
 
-    switch (m_state) {
-        case ANIM_FADE_IN:
-            if (elapsed < m_fadeInDuration) {
-                float t  = (float)elapsed / (float)m_fadeInDuration;
-                m_opacity = easeOutCubic(t);
-            } else {
-                m_opacity   = 1.0f;
-                m_state     = ANIM_HOLD;
-                m_startTime = now;
-            }
-            break;
+        auto it = m_pendingRasters.find(key);
+        if (image && it != m_pendingRasters.end() && it->second.empty()) {
+            m_prewarmImages.emplace_back(key, std::move(*image));
+            return;
+        }
 
-        case ANIM_HOLD:
-            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_startTime).count();
-            if (elapsed >= m_holdDuration) {
-                m_state     = ANIM_FADE_OUT;
-                m_startTime = now;
-            }
-            m_opacity = 1.0f;
-            break;
-
-        case ANIM_FADE_OUT:
-            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_startTime).count();
-            if (elapsed < m_fadeOutDuration) {
-                float t  = (float)elapsed / (float)m_fadeOutDuration;
-                m_opacity = 1.0f - easeInCubic(t);
-            } else {
-                m_opacity = 0.0f;
-                m_state   = ANIM_DONE;
-            }
-            break;
+        m_prewarmKeys.erase(key);
+    }
+
+    finishRaster(key, std::move(image), trace);
+}
 
-        case ANIM_DONE:
+// ring bytes a pyramid takes when every level goes to the atlas, the larger of the two layouts
+static size_t uploadBytes(const SIconImage& image) {
+    size_t bytes = (size_t)(image.width + 2) * (image.height + 2) * 4;
+    for (const auto& mip : image.mips) {
+        bytes += (size_t)(mip.width + 2) * (mip.height + 2) * 4;
+    }
+    return bytes;
+}
+
+void CIconOverlayManager::finishRaster(const STextureKey& key, std::optional<SIconImage> image, SLaunchTrace trace) {
+    auto it = m_pendingRasters.find(key);
+    if (it == m_pendingRasters.end())
+        return;
+
+    // runs from worker completions and idle slices, outside the render pass
+    g_pHyprRenderer->makeEGLCurrent();
+
+    if (!m_uploadRingTried) {
+        m_uploadRingTried = true;
+        if (!m_uploadRing.init(UPLOAD_RING_SIZE))
+            Debug::log(LOG, "[hypricons] no persistently mapped upload buffer (GL_EXT_buffer_storage), uploading from client memory");
+    }
+
+    // while uploads in flight hold the ring, wait for them instead of stalling the frame on a client-memory copy
+    const size_t BYTES = image ? uploadBytes(*image) : 0;
+    if (image && m_uploadRing.ready() && BYTES <= m_uploadRing.capacity() && !m_uploadRing.canAllocate(BYTES)) {
+        m_deferredUploads.push_back({key, std::move(*image), trace});
+        scheduleUploadPoll();
+        return;
+    }
+
+    auto waiters = std::move(it->second);
+    m_pendingRasters.erase(it);
+
+    auto region = image ? m_uploadRing.allocate(BYTES) : std::nullopt;
+    auto upload = [this, &region](const SIconImage& level) {
+        auto* staging = region ? &*region : nullptr;
+        auto  texture = m_atlas.insert(level, staging);
+        return texture ? texture : uploadIconTexture(level, staging);
+    };
+
+    trace.mark(TRACE_UPLOAD_START);
+    std::shared_ptr<SIconTexture> texture = image ? upload(*image) : nullptr;
+    if (texture) {
+        for (const auto& mip : image->mips) {
+            auto level = upload(mip);
+            if (!level)
+                break;
+            texture->bytes += level->bytes;
+            texture->mips.push_back(std::move(level));
+        }
+    }
+    if (image) {
+        for (auto& mip : image->mips) {
+            g_stagingPool.release(std::move(mip.pixels));
+        }
+        g_stagingPool.release(std::move(image->pixels));
+    }
+
+    if (!texture) {
+        if (region)
+            m_uploadRing.release(*region);
+        for (auto& weak : waiters) {
+            if (auto overlay = weak.lock())
+                overlay->cancel();
+        }
+        dropFinished();
+        return;
+    }
+
+    // shown once the GPU has the pixels, so no frame samples a texture whose upload is still running
+    m_textureCache.insert(key, texture);
+    m_uploadsInFlight.push_back({m_uploadRing.submit(), texture, std::move(waiters), trace});
+    scheduleUploadPoll();
+}
+
+// Fences are checked from onPreRender. Launches waiting on an upload keep their outputs producing
+// frames until it lands, prewarmed icons retire with whatever frame comes next.
+void CIconOverlayManager::scheduleUploadPoll() {
+    auto request = [](const std::weak_ptr<CIconOverlay>& weak) {
+        if (auto overlay = weak.lock(); overlay && overlay->getMonitor())
+            g_pCompositor->scheduleFrameForMonitor(overlay->getMonitor());
+    };
+
+    for (const auto& upload : m_uploadsInFlight) {
+        std::ranges::for_each(upload.waiters, request);
+    }
+
+    for (const auto& deferred : m_deferredUploads) {
+        if (auto it = m_pendingRasters.find(deferred.key); it != m_pendingRasters.end())
+            std::ranges::for_each(it->second, request);
+    }
+}
+
+void CIconOverlayManager::pollUploads() {
+    g_pHyprRenderer->makeEGLCurrent();
+    m_uploadRing.poll();
+
+    std::erase_if(m_uploadsInFlight, [this](SUploadInFlight& upload) {
+        if (!m_uploadRing.completed(upload.ticket))
             return false;
+
+        upload.trace.mark(TRACE_UPLOAD_END);
+        for (auto& weak : upload.waiters) {
+            auto overlay = weak.lock();
+            if (!overlay)
+                continue;
+
+            overlay->trace().merge(upload.trace);
+            showOverlay(overlay, upload.texture);
+        }
+        return true;
+    });
+
+    // retired fences free ring space for uploads that didn't fit
+    while (!m_deferredUploads.empty() && m_uploadRing.canAllocate(uploadBytes(m_deferredUploads.front().image))) {
+        auto deferred = std::move(m_deferredUploads.front());
+        m_deferredUploads.pop_front();
+        finishRaster(deferred.key, std::move(deferred.image), deferred.trace);
     }
 
-    return m_state != ANIM_DONE;
+    if (!m_uploadsInFlight.empty() || !m_deferredUploads.empty())
+        scheduleUploadPoll();
 }
 
-float CIconOverlay::getOpacity() const {
-    return m_opacity;
+// true when texture is still being uploaded, the overlay then shows once it is done
+bool CIconOverlayManager::joinUpload(const std::shared_ptr<SIconTexture>& texture, std::shared_ptr<CIconOverlay> overlay) {
+    auto upload = std::ranges::find(m_uploadsInFlight, texture, &SUploadInFlight::texture);
+    if (upload == m_uploadsInFlight.end())
+        return false;
+
+    upload->waiters.push_back(overlay);
+    scheduleUploadPoll();
+    return true;
 }
 
-bool CIconOverlay::isDone() const {
-    return m_state == ANIM_DONE;
+void CIconOverlayManager::prewarm(const std::vector<std::string>& iconNames) {
+    m_prewarmNames.insert(m_prewarmNames.end(), iconNames.begin(), iconNames.end());
+    if (!m_prewarmNames.empty())
+        schedulePrewarm(false);
+}
+
+void CIconOverlayManager::onPrewarmIdle(void* data) {
+    auto* self          = static_cast<CIconOverlayManager*>(data);
+    self->m_prewarmIdle = nullptr;
+    self->prewarmStep();
 }
 
-void CIconOverlay::draw(PHLMONITOR pMonitor) {
-    if (!m_hasTexture || !m_monitor || m_opacity <= 0.0f)
+int CIconOverlayManager::onPrewarmTimer(void* data) {
+    static_cast<CIconOverlayManager*>(data)->schedulePrewarm(false);
+    return 0;
+}
+
+void CIconOverlayManager::schedulePrewarm(bool yield) {
+    if (m_prewarmIdle)
+        return;
+
+    // idle sources re-added from an idle callback run in the same dispatch, so yielding goes through a short timer
+    if (yield) {
+        if (!m_prewarmTimer)
+            m_prewarmTimer = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &CIconOverlayManager::onPrewarmTimer, this);
+        if (m_prewarmTimer)
+            wl_event_source_timer_update(m_prewarmTimer, 1);
         return;
-    if (pMonitor != m_monitor)
+    }
+
+    m_prewarmIdle = wl_event_loop_add_idle(g_pCompositor->m_wlEventLoop, &CIconOverlayManager::onPrewarmIdle, this);
+}
+
+void CIconOverlayManager::prewarmStep() {
+    // well under a frame even at high refresh rates
+    constexpr auto SLICE = std::chrono::microseconds(2000);
+    // leave workers free for launches that happen meanwhile
+    constexpr size_t MAX_IN_FLIGHT = 2;
+
+    if (!g_pGlobalState || !g_pGlobalState->iconLoader || !g_pGlobalState->iconLookup)
         return;
-    auto data = CIconPassElement::SIconData{this};
-    g_pHyprRenderer->m_renderPass.add(makeUnique<CIconPassElement>(data));
+
+    const auto START = std::chrono::steady_clock::now();
+
+    while (!m_prewarmImages.empty() || (!m_prewarmNames.empty() && m_prewarmInFlight < MAX_IN_FLIGHT)) {
+        if (!m_prewarmImages.empty()) {
+            auto [key, image] = std::move(m_prewarmImages.front());
+            m_prewarmImages.pop_front();
+            m_prewarmKeys.erase(key);
+            finishRaster(key, std::move(image));
+        } else {
+            auto*             lookup   = g_pGlobalState->iconLookup.get();
+            const std::string iconName = std::move(m_prewarmNames.front());
+            const int         size     = g_pGlobalState->iconSize;
+            const int         scale    = lookupScale(maxOutputScale());
+            m_prewarmNames.pop_front();
+            m_prewarmInFlight++;
+
+            g_pGlobalState->iconLoader->submit([this, lookup, iconName, size, scale]() -> CIconLoader::Completion {
+                auto path = lookup->findIconByName(iconName, size, scale);
+                return [this, path] { onPrewarmResolved(path); };
+            });
+        }
+
+        if (std::chrono::steady_clock::now() - START > SLICE) {
+            schedulePrewarm(true);
+            return;
+        }
+    }
 }
 
-void CIconOverlay::renderPass() {
-    if (!m_hasTexture || !m_monitor || m_opacity <= 0.0f)
+void CIconOverlayManager::onPrewarmResolved(std::optional<std::string> path) {
+    m_prewarmInFlight--;
+    schedulePrewarm(false);
+
+    if (!path || !g_pGlobalState || !g_pGlobalState->iconLoader)
+        return;
+
+    // the same key a launch on any output will ask for
+    const STextureKey key = textureKey(*path, g_pGlobalState->iconSize, maxOutputScale());
+    if (m_pendingRasters.contains(key) || m_textureCache.get(key))
         return;
-    const auto& monBox = m_monitor->m_transformedSize;
-    double      centerX = (monBox.x - m_textureWidth) / 2.0;
-    double      centerY = (monBox.y - m_textureHeight) / 2.0;
 
-    CBox box = {centerX, centerY, (double)m_textureWidth, (double)m_textureHeight};
-    const auto TEXTURE = makeShared<CTexture>();
-    TEXTURE->m_texID = m_textureId;
-    TEXTURE->m_size = {m_textureWidth, m_textureHeight};
-    g_pHyprOpenGL->renderTexture(TEXTURE, box, {.a = m_opacity});
+    m_pendingRasters[key];
+    m_prewarmKeys.insert(key);
+    m_prewarmInFlight++;
+
+    g_pGlobalState->iconLoader->submit([this, key]() -> CIconLoader::Completion {
+        auto image = rasterizeIcon(key.path, key.pixelSize, preferredUploadFormat());
+        return [this, key, image = std::move(image)]() mutable { onIconRasterized(key, std::move(image), {}); };
+    });
 }
 
-void CIconOverlayManager::addOverlay(std::shared_ptr<CIconOverlay> overlay) {
-    m_overlays.push_back(overlay);
+// only once the shader has compiled: until the first render pass builds it, and for good if the
+// driver rejects it, update() keeps the CPU curves current for renderDirect()
+bool CIconOverlayManager::shaderAnimation() const {
+    return g_pGlobalState && g_pGlobalState->shaderAnimation && m_shader.ready();
+}
+
+CIconShader* CIconOverlayManager::shader() {
+    if (m_shaderFailed)
+        return nullptr;
+
+    // built on first use, from the render pass where the compositor's context is current
+    if (!m_shader.ready() && !m_shader.compile()) {
+        m_shaderFailed = true;
+        Debug::log(ERR, "[hypricons] overlay shader unavailable, drawing overlays one by one and animating on the CPU: {}", m_shader.error());
+        return nullptr;
+    }
+
+    return &m_shader;
+}
+
+void CIconOverlayManager::showOverlay(std::shared_ptr<CIconOverlay> overlay, std::shared_ptr<SIconTexture> texture) {
+    if (!overlay->setTexture(std::move(texture))) {
+        // too late, never drawn
+        dropFinished();
+        return;
+    }
+
+    // schedules the frame that starts the fade-in, later frames are requested from onPreRender
+    overlay->damage();
 }
 
-void CIconOverlayManager::update() {
+// Overlays that end before they are drawn need no frame to clear them. Removing them right away
+// frees their admission slot even when their output isn't rendering.
+void CIconOverlayManager::dropFinished() {
+    std::erase_if(m_overlays, [](const auto& overlay) { return !overlay || overlay->isDone(); });
+
+    if (m_admission.queued())
+        pumpAdmission();
+}
+
+int CIconOverlayManager::onDeadlineTimer(void* data) {
+    auto*      self = static_cast<CIconOverlayManager*>(data);
+    const auto NOW  = std::chrono::steady_clock::now();
+    for (auto& overlay : self->m_overlays) {
+        if (overlay && overlay->isLoading())
+            overlay->update(NOW);
+    }
+
+    self->dropFinished();
+    self->scheduleDeadline();
+    return 0;
+}
+
+void CIconOverlayManager::scheduleDeadline() {
+    std::optional<std::chrono::steady_clock::time_point> next;
+    for (const auto& overlay : m_overlays) {
+        if (overlay && overlay->isLoading() && (!next || overlay->loadDeadline() < *next))
+            next = overlay->loadDeadline();
+    }
+
+    if (!next)
+        return;
+
+    if (!m_deadlineTimer)
+        m_deadlineTimer = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &CIconOverlayManager::onDeadlineTimer, this);
+    if (m_deadlineTimer)
+        wl_event_source_timer_update(m_deadlineTimer, std::max<int>(1, std::chrono::ceil<std::chrono::milliseconds>(*next - std::chrono::steady_clock::now()).count() + 1));
+}
+
+// When the frame being prepared reaches the screen: one refresh after the last presentation, or
+// now when the output was idle and this frame starts a new run.
+static std::chrono::steady_clock::time_point presentationTime(PHLMONITOR monitor) {
+    const auto NOW = std::chrono::steady_clock::now();
+    if (monitor->m_refreshRate <= 0.0f)
+        return NOW;
+
+    const auto INTERVAL = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / monitor->m_refreshRate));
+    const auto NEXT     = monitor->m_lastPresentationTimer.chrono() + INTERVAL;
+    return NEXT < NOW || NEXT - NOW > INTERVAL ? NOW : NEXT;
+}
+
+// Runs once per frame of each monitor, so animations advance in step with that monitor's
+// refresh and nothing runs while no overlay is on screen.
+void CIconOverlayManager::onPreRender(PHLMONITOR monitor) {
+    // upload fences are checked once per frame, launches waiting on them request the frames
+    if (!m_uploadsInFlight.empty() || !m_deferredUploads.empty())
+        pollUploads();
+
+    if (m_overlays.empty() || !monitor)
+        return;
+
+    // animations are sampled at presentation, not whenever the render loop got to this output
+    const auto FRAMETIME = presentationTime(monitor);
+    m_frameTime          = FRAMETIME;
+
     m_overlays.erase(
         std::remove_if(m_overlays.begin(), m_overlays.end(),
-                       [](std::shared_ptr<CIconOverlay>& overlay) {
+                       [&](std::shared_ptr<CIconOverlay>& overlay) {
                            if (!overlay)
                                return true;
-                           overlay->update();
+                           // no more frames will come from a disabled output
+                           if (!overlay->getMonitor() || !overlay->getMonitor()->m_enabled)
+                               overlay->cancel();
+                           if (overlay->getMonitor() != monitor)
+                               return overlay->isDone();
+
+                           overlay->update(FRAMETIME);
+                           // requests the next frame, and on the last one clears what's left of the icon
+                           overlay->damage();
                            return overlay->isDone();
                        }),
         m_overlays.end());
-    if (!m_overlays.empty()) {
-        for (auto& m : g_pCompositor->m_monitors) {
-            g_pHyprRenderer->damageMonitor(m);
+    layoutOverlays(monitor);
+    m_textureCache.trim();
+
+    // finished overlays make room for queued launches
+    if (m_admission.queued())
+        pumpAdmission();
+}
+
+// Offsets from the output's center for count icons in square cells, in launch order.
+static std::vector<Vector2D> layoutSlots(eIconLayout layout, size_t count, double cell, const Vector2D& area) {
+    std::vector<Vector2D> slots(count);
+    if (layout == ICON_LAYOUT_CENTER || count < 2)
+        return slots;
+
+    // a quarter of an icon between neighbours
+    const double pitch   = std::round(cell * 1.25);
+    const size_t fit     = area.x > cell ? (size_t)((area.x - cell) / pitch) + 1 : 1;
+    const size_t wanted  = layout == ICON_LAYOUT_ROW ? count : (size_t)std::ceil(std::sqrt((double)count));
+    const size_t columns = std::clamp(wanted, (size_t)1, fit);
+    const size_t rows    = (count + columns - 1) / columns;
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t row = i / columns;
+        // a partial last row is centered on its own
+        const size_t inRow = std::min(columns, count - row * columns);
+        slots[i]           = {std::round(((double)(i % columns) - (inRow - 1) / 2.0) * pitch), std::round(((double)row - (rows - 1) / 2.0) * pitch)};
+    }
+
+    return slots;
+}
+
+void CIconOverlayManager::layoutOverlays(PHLMONITOR monitor) {
+    std::vector<CIconOverlay*> visible;
+    int                        iconSize = 0;
+    for (auto& overlay : m_overlays) {
+        if (overlay && overlay->getMonitor() == monitor && overlay->isVisible()) {
+            visible.push_back(overlay.get());
+            iconSize = std::max(iconSize, overlay->getIconSize());
         }
     }
+
+    const auto LAYOUT = g_pGlobalState ? g_pGlobalState->layout : ICON_LAYOUT_CENTER;
+    const auto slots  = layoutSlots(LAYOUT, visible.size(), std::round(iconSize * monitor->m_scale), monitor->m_transformedSize);
+    for (size_t i = 0; i < visible.size(); i++) {
+        // the old position was damaged by this frame already, the new one has to be as well
+        if (visible[i]->setSlot(slots[i]))
+            visible[i]->damage();
+    }
+}
+
+void CIconOverlayManager::drawAll(PHLMONITOR monitor) {
+    if (!monitor)
+        return;
+
+    // a single element draws every overlay on the output, however many apps launched together
+    const bool VISIBLE = std::ranges::any_of(m_overlays, [&](const auto& overlay) { return overlay && overlay->getMonitor() == monitor && overlay->isVisible(); });
+    if (VISIBLE)
+        g_pHyprRenderer->m_renderPass.add(makeUnique<CIconPassElement>(CIconPassElement::SIconData{this, monitor}));
 }
 
-void CIconOverlayManager::drawAll() {
+void CIconOverlayManager::renderMonitor(PHLMONITOR monitor, const CRegion& damage) {
+    std::vector<CIconOverlay*> overlays;
     for (auto& overlay : m_overlays) {
-        if (overlay && !overlay->isDone()) {
-            overlay->draw(overlay->getMonitor());
+        if (overlay && overlay->getMonitor() == monitor && overlay->isVisible())
+            overlays.push_back(overlay.get());
+    }
+
+    auto* shader = this->shader();
+    if (!shader) {
+        for (auto* overlay : overlays) {
+            overlay->renderDirect();
         }
+        return;
     }
+
+    struct SBatch {
+        GLuint                     texture = 0;
+        std::vector<SIconInstance> instances;
+    };
+
+    // one instanced draw per texture sampled, normally a single atlas page for every overlay
+    const bool          GPU     = shaderAnimation();
+    bool                covered = true;
+    std::vector<SBatch> batches;
+    for (auto* overlay : overlays) {
+        SIconInstance instance;
+        const GLuint  texture = overlay->instance(m_animationEpoch, GPU, instance);
+        if (!texture)
+            continue;
+
+        auto batch = std::ranges::find(batches, texture, &SBatch::texture);
+        if (batch == batches.end())
+            batch = batches.insert(batches.end(), SBatch{.texture = texture});
+        batch->instances.push_back(instance);
+
+        covered = covered && CRegion{overlay->drawBox()}.subtract(damage).empty();
+        overlay->markDrawn();
+    }
+
+    const float time = std::chrono::duration<float>(m_frameTime - m_animationEpoch).count();
+
+    if (covered) {
+        // every overlay damages its whole box each frame, so nothing drawn can land outside the damage
+        // and the batches don't have to be repeated per damage rectangle
+        CBox extents = CRegion{damage}.getExtents();
+        g_pHyprOpenGL->scissor(&extents);
+        for (const auto& batch : batches) {
+            shader->draw(batch.texture, batch.instances, time);
+        }
+    } else {
+        for (const auto& rect : damage.getRects()) {
+            g_pHyprOpenGL->scissor(&rect);
+            for (const auto& batch : batches) {
+                shader->draw(batch.texture, batch.instances, time);
+            }
+        }
+    }
+    g_pHyprOpenGL->scissor(nullptr);
+}
+
+// monitor-local logical coordinates, like the renderer's own pass elements
+std::optional<CBox> CIconOverlayManager::boundingBox(PHLMONITOR monitor) const {
+    std::optional<CBox> bounds;
+    for (auto& overlay : m_overlays) {
+        if (!overlay || overlay->getMonitor() != monitor || !overlay->isVisible())
+            continue;
+
+        const CBox box = overlay->drawBox();
+        if (!bounds) {
+            bounds = box;
+            continue;
+        }
+
+        const double left   = std::min(bounds->x, box.x);
+        const double top    = std::min(bounds->y, box.y);
+        const double right  = std::max(bounds->x + bounds->w, box.x + box.w);
+        const double bottom = std::max(bounds->y + bounds->h, box.y + box.h);
+        bounds              = CBox{left, top, right - left, bottom - top};
+    }
+
+    if (!bounds || !monitor)
+        return std::nullopt;
+
+    return bounds->scale(1.0 / monitor->m_scale).round();
 }
@@ -2,81 +2,222 @@
 
 #include "globals.hpp"
 #include "IconLookup.hpp"
+#include "TextureCache.hpp"
+#include "IconAtlas.hpp"
+#include "IconLoader.hpp"
+#include "IconRasterizer.hpp"
+#include "LaunchHistory.hpp"
+#include "LaunchAdmission.hpp"
+#include "IconAnimation.hpp"
+#include "IconShader.hpp"
+#include "UploadRing.hpp"
 
 #include <hyprland/src/render/pass/PassElement.hpp>
 #include <hyprland/src/helpers/Monitor.hpp>
 
-#include <cairo/cairo.h>
-#include <librsvg/rsvg.h>
 #include <GLES3/gl32.h>
 
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <string>
 #include <memory>
+#include <unordered_set>
 
 enum eAnimationState {
+    ANIM_LOADING,
     ANIM_FADE_IN,
     ANIM_HOLD,
     ANIM_FADE_OUT,
     ANIM_DONE
 };
 
+// how overlays showing at the same time on one output are placed
+enum eIconLayout {
+    ICON_LAYOUT_CENTER, // stacked at the center
+    ICON_LAYOUT_ROW,    // side by side, wrapping when the output is too narrow
+    ICON_LAYOUT_GRID    // a square-ish grid around the center
+};
+
 class CIconOverlay {
   public:
-    CIconOverlay(const std::string& appClass, PHLMONITOR monitor);
+    CIconOverlay(const std::string& appClass, PHLMONITOR monitor, pid_t pid = 0);
     ~CIconOverlay();
 
-    bool update();
+    bool update(std::chrono::steady_clock::time_point frameTime);
+    bool setTexture(std::shared_ptr<SIconTexture> texture);
+    void cancel();
     float getOpacity() const;
     bool isDone() const;
+    bool isLoading() const { return m_state == ANIM_LOADING; }
+    std::chrono::steady_clock::time_point loadDeadline() const { return m_startTime + std::chrono::milliseconds(m_loadDeadline); }
+    bool isVisible() const { return m_texture && m_monitor && m_state != ANIM_LOADING && m_state != ANIM_DONE; }
+    const std::string& getAppClass() const { return m_appClass; }
+    pid_t getPid() const { return m_pid; }
     PHLMONITOR getMonitor() const { return m_monitor; }
-    void draw(PHLMONITOR pMonitor);
-    void renderPass();
-    GLuint getTextureId() const { return m_textureId; }
+    GLuint instance(std::chrono::steady_clock::time_point epoch, bool shaderAnimation, SIconInstance& out) const;
+    void renderDirect();
+    void markDrawn();
+    bool setSlot(const Vector2D& offset);
+    CBox pixelBox() const;
+    CBox drawBox() const;
+    CBox logicalBox() const;
+    void damage() const;
+    bool hasTexture() const { return m_texture != nullptr; }
+    const SIconTexture* texture() const { return m_texture.get(); }
     int getIconSize() const { return m_iconSize; }
+    SLaunchTrace& trace() { return m_trace; }
+    SIconAnimation animation(std::chrono::steady_clock::time_point epoch) const;
 
   private:
-    bool loadIcon(const std::string& iconPath);
-    bool loadSvgIcon(const std::string& path);
-    bool loadPngIcon(const std::string& path);
-    bool createTextureFromSurface(cairo_surface_t* surface);
-
     PHLMONITOR m_monitor;
     std::string m_appClass;
+    pid_t m_pid = 0;
     std::chrono::steady_clock::time_point m_startTime;
-    eAnimationState m_state = ANIM_FADE_IN;
+    eAnimationState m_state = ANIM_LOADING;
     int m_fadeInDuration  = 150;
     int m_holdDuration    = 300;
     int m_fadeOutDuration = 400;
+    int m_loadDeadline    = 500;
     float m_opacity = 0.0f;
-    GLuint m_textureId = 0;
-    bool m_hasTexture = false;
+    float m_scale   = 1.0f;
+    float m_scaleIn = 1.0f;
+    std::shared_ptr<SIconTexture> m_texture;
     int m_iconSize = 128;
-    int m_textureWidth = 0;
-    int m_textureHeight = 0;
+    Vector2D m_slot; // offset from the output's center given by the layout, in pixels
+    SLaunchTrace m_trace;
+    bool m_traced = false;
+};
+
+struct SOverlayStats {
+    size_t overlays        = 0;
+    size_t loading         = 0;
+    size_t overlayTextures = 0; // distinct textures live overlays draw from
+    size_t overlayBytes    = 0; // their GL memory, mips included
+    size_t cachedTextures  = 0;
+    size_t cachedBytes     = 0;
+    size_t atlasPages      = 0;
+    size_t atlasBytes      = 0;
+    size_t atlasIcons      = 0;
+    size_t uploadsInFlight = 0;
+    size_t uploadRingBytes = 0;
+    size_t queuedLaunches  = 0;
+    SAdmissionStats admission;
 };
 
 class CIconOverlayManager {
   public:
     CIconOverlayManager() = default;
-    ~CIconOverlayManager() = default;
+    ~CIconOverlayManager();
 
+    // goes through admission control first; false when coalesced into a recent launch or dropped
+    bool requestLaunch(const std::string& appClass, PHLMONITOR monitor, pid_t pid = 0);
     void addOverlay(std::shared_ptr<CIconOverlay> overlay);
-    void update();
-    void drawAll();
+    // icon names as CIconLookup::findIconPath() gives them, see CLaunchHistory
+    void prewarm(const std::vector<std::string>& iconNames);
+    // called with that icon name once a launch is resolved, whether or not it finds a file
+    void setLaunchResolved(std::function<void(const std::string& iconName)> callback) { m_onLaunchResolved = std::move(callback); }
+    void onPreRender(PHLMONITOR monitor);
+    void drawAll(PHLMONITOR monitor);
+    void renderMonitor(PHLMONITOR monitor, const CRegion& damage);
+    std::optional<CBox> boundingBox(PHLMONITOR monitor) const;
     bool hasActiveOverlays() const { return !m_overlays.empty(); }
+    CIconTextureCache& textureCache() { return m_textureCache; }
+    CIconAtlas& atlas() { return m_atlas; }
+    CLaunchAdmission& admission() { return m_admission; }
+    SOverlayStats stats() const;
+
+    // the batched renderer, nullptr when the driver rejected the shader; shaderAnimation()
+    // tells whether it also evaluates the animation curves instead of the CPU, which needs it compiled
+    bool shaderAnimation() const;
+    CIconShader* shader();
+    std::chrono::steady_clock::time_point animationEpoch() const { return m_animationEpoch; }
 
   private:
+    void onIconResolved(std::weak_ptr<CIconOverlay> overlay, std::optional<std::string> path, const SLaunchTrace& trace);
+    void onIconRasterized(const STextureKey& key, std::optional<SIconImage> image, SLaunchTrace trace);
+    void finishRaster(const STextureKey& key, std::optional<SIconImage> image, SLaunchTrace trace = {});
+    bool joinUpload(const std::shared_ptr<SIconTexture>& texture, std::shared_ptr<CIconOverlay> overlay);
+    void scheduleUploadPoll();
+    void pollUploads();
+    void showOverlay(std::shared_ptr<CIconOverlay> overlay, std::shared_ptr<SIconTexture> texture);
+    void layoutOverlays(PHLMONITOR monitor);
+    void dropFinished();
+
+    static int onDeadlineTimer(void* data);
+    void scheduleDeadline();
+
+    static int onAdmissionTimer(void* data);
+    void pumpAdmission();
+
+    static void onPrewarmIdle(void* data);
+    static int onPrewarmTimer(void* data);
+    void schedulePrewarm(bool yield);
+    void prewarmStep();
+    void onPrewarmResolved(std::optional<std::string> path);
+
+    CIconAtlas m_atlas; // declared first, outlives every texture handle below
     std::vector<std::shared_ptr<CIconOverlay>> m_overlays;
+    CIconTextureCache m_textureCache;
+    CIconShader m_shader;
+    bool m_shaderFailed = false;
+    std::chrono::steady_clock::time_point m_animationEpoch;
+    std::chrono::steady_clock::time_point m_frameTime;
+    std::unordered_map<STextureKey, std::vector<std::weak_ptr<CIconOverlay>>, STextureKeyHash> m_pendingRasters;
+
+    // icons still to warm up, and rasterized ones nobody is waiting for yet, uploaded in idle slices
+    std::deque<std::string> m_prewarmNames;
+    std::deque<std::pair<STextureKey, SIconImage>> m_prewarmImages;
+    std::unordered_set<STextureKey, STextureKeyHash> m_prewarmKeys;
+    size_t m_prewarmInFlight = 0;
+    wl_event_source* m_prewarmIdle = nullptr;
+    wl_event_source* m_prewarmTimer = nullptr;
+
+    // uploads read from the ring asynchronously; overlays wait for their fence instead of a frame waiting on the copy
+    struct SUploadInFlight {
+        uint64_t ticket = 0;
+        std::shared_ptr<SIconTexture> texture;
+        std::vector<std::weak_ptr<CIconOverlay>> waiters;
+        SLaunchTrace trace;
+    };
+
+    struct SDeferredUpload {
+        STextureKey key;
+        SIconImage image;
+        SLaunchTrace trace;
+    };
+
+    static constexpr size_t UPLOAD_RING_SIZE = 8 * 1024 * 1024;
+
+    CUploadRing m_uploadRing;
+    bool m_uploadRingTried = false;
+    std::vector<SUploadInFlight> m_uploadsInFlight;
+    std::deque<SDeferredUpload> m_deferredUploads;
+
+    std::function<void(const std::string&)> m_onLaunchResolved;
+
+    CLaunchAdmission m_admission;
+    wl_event_source* m_admissionTimer = nullptr;
+    wl_event_source* m_deadlineTimer = nullptr; // expires loading overlays on outputs that aren't rendering
 };
 
 struct SGlobalState {
     std::unique_ptr<CIconLookup>        iconLookup;
     std::unique_ptr<CIconOverlayManager> overlayManager;
-    wl_event_source*                    tickSource = nullptr;
-    int   iconSize       = 128;
-    int   fadeInMs       = 150;
-    int   holdMs         = 300;
-    int   fadeOutMs      = 400;
-    bool  enabled        = true;
+    std::unique_ptr<CLaunchHistory>     launchHistory;
+    std::unique_ptr<CIconLoader>        iconLoader; // destroyed first, so no worker outlives the lookup or manager
+    wl_event_source*                    watchSource = nullptr;
+    wl_event_source*                    historyTimer = nullptr; // debounced launch history save
+    SP<SHyprCtlCommand>                 statsCommand;
+    int   iconSize        = 128;
+    int   fadeInMs        = 150;
+    int   holdMs          = 300;
+    int   fadeOutMs       = 400;
+    int   textureCacheMb  = 32;
+    int   loadDeadlineMs  = 500;
+    int   prewarmCount    = 8;
+    bool  shaderAnimation = false;
+    float scaleIn         = 1.0f; // icon scale at the start of the fade-in
+    eIconLayout layout    = ICON_LAYOUT_CENTER;
+    bool  enabled         = true;
 };
@@ -7,12 +7,15 @@
 CIconPassElement::CIconPassElement(const SIconData& data) : m_data(data) {}
 
 void CIconPassElement::draw(const CRegion& damage) {
-    if (!m_data.overlay)
+    if (!m_data.manager || !m_data.monitor)
         return;
 
-    m_data.overlay->renderPass();
+    m_data.manager->renderMonitor(m_data.monitor, damage);
 }
 
 std::optional<CBox> CIconPassElement::boundingBox() {
-    return std::nullopt;
+    if (!m_data.manager || !m_data.monitor)
+        return std::nullopt;
+
+    return m_data.manager->boundingBox(m_data.monitor);
 }
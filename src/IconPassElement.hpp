@@ -4,12 +4,14 @@
 #include <hyprland/src/helpers/Monitor.hpp>
 #include <GLES3/gl32.h>
 
-class CIconOverlay;
+class CIconOverlayManager;
 
+// Every overlay on one monitor, drawn together.
 class CIconPassElement : public IPassElement {
   public:
     struct SIconData {
-        CIconOverlay* overlay = nullptr;
+        CIconOverlayManager* manager = nullptr;
+        PHLMONITOR           monitor;
     };
 
     CIconPassElement(const SIconData& data);
@@ -0,0 +1,118 @@
+#include "IconRasterizer.hpp"
+#include "IconDecoder.hpp"
+#include "StagingPool.hpp"
+
+#include <cairo/cairo.h>
+#include <librsvg/rsvg.h>
+
+#include <algorithm>
+#include <cstring>
+
+// cairo draws straight into a recycled staging buffer, so nothing is copied afterwards
+static cairo_surface_t* createImageSurface(SIconImage& image, int width, int height) {
+    image.width  = width;
+    image.height = height;
+    image.format = PIXEL_FORMAT_BGRA;
+    image.pixels = g_stagingPool.acquire((size_t)width * height * 4);
+
+    // recycled buffers hold the previous icon, and painting a transparent source with OVER doesn't clear
+    std::memset(image.pixels.data(), 0, image.pixels.size());
+
+    return cairo_image_surface_create_for_data(image.pixels.data(), CAIRO_FORMAT_ARGB32, width, height, width * 4);
+}
+
+static std::optional<SIconImage> rasterizeSvg(const std::string& path, int size, SLaunchTrace& trace) {
+    GError*     error  = nullptr;
+    RsvgHandle* handle = rsvg_handle_new_from_file(path.c_str(), &error);
+
+    if (!handle) {
+        if (error) {
+            g_error_free(error);
+        }
+        return std::nullopt;
+    }
+
+    trace.mark(TRACE_DECODE_END);
+
+    gdouble width, height;
+    rsvg_handle_get_intrinsic_size_in_pixels(handle, &width, &height);
+
+    if (width <= 0 || height <= 0) {
+        width  = size;
+        height = size;
+    }
+
+    double scale        = std::min((double)size / width, (double)size / height);
+    int    renderWidth  = (int)(width * scale);
+    int    renderHeight = (int)(height * scale);
+
+    if (renderWidth <= 0 || renderHeight <= 0) {
+        g_object_unref(handle);
+        return std::nullopt;
+    }
+
+    SIconImage       image;
+    cairo_surface_t* surface = createImageSurface(image, renderWidth, renderHeight);
+    cairo_t*         cr      = cairo_create(surface);
+
+    cairo_scale(cr, scale, scale);
+
+    RsvgRectangle viewport = {0, 0, width, height};
+    rsvg_handle_render_document(handle, cr, &viewport, nullptr);
+
+    cairo_destroy(cr);
+    g_object_unref(handle);
+    cairo_surface_destroy(surface);
+    trace.mark(TRACE_RENDER_END);
+
+    return image;
+}
+
+// Halving from the full-size render keeps librsvg out of smaller draws, and averaging premultiplied
+// pixels needs no conversion either way.
+static void generateMips(SIconImage& image) {
+    image.mips.clear();
+    while (true) {
+        const SIconImage& previous = image.mips.empty() ? image : image.mips.back();
+        if (previous.width / 2 < MIN_MIP_SIZE || previous.height / 2 < MIN_MIP_SIZE)
+            break;
+
+        SIconImage mip;
+        mip.width  = previous.width / 2;
+        mip.height = previous.height / 2;
+        mip.format = image.format;
+        mip.pixels = g_stagingPool.acquire((size_t)mip.width * mip.height * 4);
+        downsampleHalf(previous.pixels.data(), previous.width, previous.height, mip.pixels.data());
+        image.mips.push_back(std::move(mip));
+    }
+}
+
+std::optional<SIconImage> rasterizeIcon(const std::string& path, int size, ePixelFormat format, SLaunchTrace* trace) {
+    SLaunchTrace local;
+    SLaunchTrace& stages = trace ? *trace : local;
+    stages.mark(TRACE_RASTER_START);
+
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    std::optional<SIconImage> image;
+    if (ext == "svg") {
+        image = rasterizeSvg(path, size, stages);
+    } else if (ext == "png" || ext == "xpm") {
+        // decoded and scaled in one go, there is no separate render stage
+        image = ext == "png" ? decodePng(path, size, format) : decodeXpm(path, size, format);
+        stages.mark(TRACE_DECODE_END);
+        stages.mark(TRACE_RENDER_END);
+    }
+
+    if (image && image->format != format) {
+        swizzleRedBlue(image->pixels.data(), image->pixels.data(), (size_t)image->width * image->height);
+        image->format = format;
+    }
+    if (image) {
+        generateMips(*image);
+        stages.mark(TRACE_CONVERT_END);
+    }
+
+    return image;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "PixelConvert.hpp"
+#include "LaunchTrace.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// CPU-side icon image, tightly packed premultiplied 32-bit pixels. The buffer comes from
+// g_stagingPool and should be released back to it once uploaded.
+struct SIconImage {
+    int                     width  = 0;
+    int                     height = 0;
+    ePixelFormat            format = PIXEL_FORMAT_BGRA;
+    std::vector<uint8_t>    pixels;
+
+    // box-filtered levels below this one, each half the size of the previous
+    std::vector<SIconImage> mips;
+};
+
+// mip levels stop before either side would drop below this
+constexpr int MIN_MIP_SIZE = 16;
+
+// Decodes and rasterizes an icon file to fit inside size x size, converted to the given layout,
+// with its mip chain. Safe to call from any thread; stage timestamps go to trace when given.
+std::optional<SIconImage> rasterizeIcon(const std::string& path, int size, ePixelFormat format = PIXEL_FORMAT_BGRA, SLaunchTrace* trace = nullptr);
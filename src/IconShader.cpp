@@ -0,0 +1,230 @@
+#include "IconShader.hpp"
+
+// Every input but the frame time is per instance. timing = (start, fade in, hold, fade out) in seconds,
+// style = (scale at the start of the fade-in, opacity or -1). Mirrors animationOpacity/animationScale,
+// once per vertex since both are constant across a quad; highp because start and time are only close, not small.
+static constexpr const char* VERTEX = R"(
+uniform float time;
+
+in vec2 pos;
+in mat3 proj;
+in vec4 uvRect;
+in vec4 timing;
+in vec2 style;
+
+out vec2       v_texcoord;
+flat out float v_opacity;
+
+float easeOutCubic(float t) {
+    float u = 1.0 - t;
+    return 1.0 - u * u * u;
+}
+
+float opacity(float elapsed) {
+    if (elapsed < 0.0)
+        return 0.0;
+    if (elapsed < timing.y)
+        return easeOutCubic(elapsed / timing.y);
+    elapsed -= timing.y;
+    if (elapsed < timing.z)
+        return 1.0;
+    elapsed -= timing.z;
+    if (elapsed < timing.w) {
+        float t = elapsed / timing.w;
+        return 1.0 - t * t * t;
+    }
+    return 0.0;
+}
+
+void main() {
+    float elapsed = time - timing.x;
+    float scale   = style.x;
+    v_opacity     = style.y;
+    if (style.y < 0.0) {
+        scale     = elapsed < 0.0 ? style.x : elapsed >= timing.y ? 1.0 : mix(style.x, 1.0, easeOutCubic(elapsed / timing.y));
+        v_opacity = opacity(elapsed);
+    }
+
+    gl_Position = vec4(proj * vec3((pos - 0.5) * scale + 0.5, 1.0), 1.0);
+    v_texcoord  = mix(uvRect.xy, uvRect.zw, pos);
+}
+)";
+
+static constexpr const char* FRAGMENT = R"(
+uniform sampler2D tex;
+
+in vec2       v_texcoord;
+flat in float v_opacity;
+out vec4      fragColor;
+
+void main() {
+    // premultiplied, so fading scales every channel
+    fragColor = texture(tex, v_texcoord) * v_opacity;
+}
+)";
+
+// floats per instance: projection columns, uvRect, timing, style
+constexpr int INSTANCE_FLOATS = 9 + 4 + 4 + 2;
+
+static GLuint compileStage(GLenum type, const char* body, std::string& error) {
+    const char* sources[] = {"#version 300 es\nprecision highp float;\n", body};
+
+    GLuint      shader = glCreateShader(type);
+    glShaderSource(shader, 2, sources, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok)
+        return shader;
+
+    char log[1024] = {};
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    error = std::string(type == GL_VERTEX_SHADER ? "vertex shader: " : "fragment shader: ") + log;
+    glDeleteShader(shader);
+    return 0;
+}
+
+CIconShader::~CIconShader() {
+    destroy();
+}
+
+bool CIconShader::compile() {
+    destroy();
+
+    const GLuint vertex   = compileStage(GL_VERTEX_SHADER, VERTEX, m_error);
+    const GLuint fragment = vertex ? compileStage(GL_FRAGMENT_SHADER, FRAGMENT, m_error) : 0;
+    if (!fragment) {
+        if (vertex)
+            glDeleteShader(vertex);
+        return false;
+    }
+
+    m_program = glCreateProgram();
+    glAttachShader(m_program, vertex);
+    glAttachShader(m_program, fragment);
+    glLinkProgram(m_program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024] = {};
+        glGetProgramInfoLog(m_program, sizeof(log), nullptr, log);
+        m_error = std::string("link: ") + log;
+        destroy();
+        return false;
+    }
+
+    m_time = glGetUniformLocation(m_program, "time");
+    m_tex  = glGetUniformLocation(m_program, "tex");
+
+    // the unit square as a strip; texture coordinates are derived from it in the vertex stage
+    static constexpr float QUAD[] = {0, 0, 1, 0, 0, 1, 1, 1};
+
+    GLint                  previousVao = 0, previousBuffer = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousBuffer);
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_instances);
+    glBindVertexArray(m_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD), QUAD, GL_STATIC_DRAW);
+    const GLint POS = glGetAttribLocation(m_program, "pos");
+    glEnableVertexAttribArray(POS);
+    glVertexAttribPointer(POS, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    // everything else advances once per quad; a mat3 attribute takes one location per column
+    glBindBuffer(GL_ARRAY_BUFFER, m_instances);
+    auto instanced = [](GLint location, int size, int offset) {
+        if (location < 0)
+            return;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (const void*)(offset * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+    };
+    const GLint PROJ = glGetAttribLocation(m_program, "proj");
+    for (int column = 0; PROJ >= 0 && column < 3; column++) {
+        instanced(PROJ + column, 3, column * 3);
+    }
+    instanced(glGetAttribLocation(m_program, "uvRect"), 4, 9);
+    instanced(glGetAttribLocation(m_program, "timing"), 4, 13);
+    instanced(glGetAttribLocation(m_program, "style"), 2, 17);
+
+    glBindVertexArray(previousVao);
+    glBindBuffer(GL_ARRAY_BUFFER, previousBuffer);
+
+    m_error.clear();
+    return true;
+}
+
+void CIconShader::destroy() {
+    if (m_vbo)
+        glDeleteBuffers(1, &m_vbo);
+    if (m_instances)
+        glDeleteBuffers(1, &m_instances);
+    if (m_vao)
+        glDeleteVertexArrays(1, &m_vao);
+    if (m_program)
+        glDeleteProgram(m_program);
+
+    m_vbo       = 0;
+    m_instances = 0;
+    m_vao       = 0;
+    m_program   = 0;
+}
+
+void CIconShader::draw(GLuint texture, std::span<const SIconInstance> instances, float time) {
+    if (!m_program || instances.empty())
+        return;
+
+    m_instanceData.clear();
+    for (const auto& instance : instances) {
+        // GL reads matrices column by column
+        const auto& m = instance.projection;
+        const auto& a = instance.animation;
+        m_instanceData.insert(m_instanceData.end(),
+                              {m[0], m[3], m[6], m[1], m[4], m[7], m[2], m[5], m[8], instance.uvRect[0], instance.uvRect[1], instance.uvRect[2], instance.uvRect[3],
+                               a.start, a.fadeIn, a.hold, a.fadeOut, a.scaleFrom, instance.opacity});
+    }
+
+    // the compositor caches its own bindings, so everything touched here is put back
+    GLint previousProgram = 0, previousVao = 0, previousBuffer = 0, previousActive = 0, previousTexture = 0, previousSrc = 0, previousDst = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousBuffer);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActive);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &previousSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &previousDst);
+    const GLboolean previousBlend = glIsEnabled(GL_BLEND);
+
+    glUseProgram(m_program);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(m_tex, 0);
+    glUniform1f(m_time, time);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // orphaned every call, the driver hands out fresh storage instead of waiting on the last frame
+    glBindBuffer(GL_ARRAY_BUFFER, m_instances);
+    glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(float), m_instanceData.data(), GL_STREAM_DRAW);
+
+    glBindVertexArray(m_vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
+
+    glBindVertexArray(previousVao);
+    glBindBuffer(GL_ARRAY_BUFFER, previousBuffer);
+    glBindTexture(GL_TEXTURE_2D, previousTexture);
+    glActiveTexture(previousActive);
+    glUseProgram(previousProgram);
+    glBlendFunc(previousSrc, previousDst);
+    if (!previousBlend)
+        glDisable(GL_BLEND);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IconAnimation.hpp"
+
+#include <GLES3/gl32.h>
+
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+
+// One icon quad of an instanced draw.
+struct SIconInstance {
+    std::array<float, 9> projection = {}; // unit square to clip space, row-major like Hyprland's Mat3x3
+    std::array<float, 4> uvRect     = {0, 0, 1, 1}; // (left, top, right, bottom) in the texture
+    SIconAnimation       animation;
+    // >= 0 when the curves were already evaluated on the CPU: used as is, with animation.scaleFrom as the current scale
+    float                opacity = -1.0f;
+};
+
+// Draws any number of icon quads sharing a texture with a single instanced call. Opacity and scale
+// are evaluated per instance on the GPU from the frame time, so an overlay's animation is handed
+// over once instead of being stepped on the CPU every frame. Plain GLES 3 with no compositor
+// state, so it also runs headless.
+class CIconShader {
+  public:
+    CIconShader() = default;
+    ~CIconShader();
+
+    CIconShader(const CIconShader&)            = delete;
+    CIconShader& operator=(const CIconShader&) = delete;
+
+    // Needs a current GLES 3 context. On failure the reason is kept in error().
+    bool               compile();
+    void               destroy();
+    bool               ready() const { return m_program != 0; }
+    const std::string& error() const { return m_error; }
+
+    // texture is a GL_TEXTURE_2D holding every instance's pixels. Leaves the caller's GL state as it was.
+    void draw(GLuint texture, std::span<const SIconInstance> instances, float time);
+
+  private:
+    GLuint             m_program   = 0;
+    GLuint             m_vao       = 0;
+    GLuint             m_vbo       = 0;
+    GLuint             m_instances = 0;
+
+    GLint              m_time = -1;
+    GLint              m_tex  = -1;
+
+    std::vector<float> m_instanceData;
+    std::string        m_error;
+};
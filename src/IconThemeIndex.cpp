@@ -0,0 +1,675 @@
+#include "IconThemeIndex.hpp"
+#include "LookupSnapshot.hpp"
+
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<const char*, 3> EXTENSIONS = {".svg", ".png", ".xpm"};
+static constexpr std::array<const char*, 3> SUBDIRS    = {"apps", "applications", ""};
+// the spec's png, svg, xpm order, indexed by eIconExtension
+static constexpr std::array<int, 3> EXTENSION_RANK = {1, 0, 2};
+
+static std::optional<eIconExtension> extensionFromString(const std::string& ext) {
+    if (ext == ".svg")
+        return ICON_EXT_SVG;
+    if (ext == ".png")
+        return ICON_EXT_PNG;
+    if (ext == ".xpm")
+        return ICON_EXT_XPM;
+    return std::nullopt;
+}
+
+// "NxN", "NxN@S" or "scalable", for themes that ship without an index.theme
+static std::optional<SIconDirectory> directoryFromName(const std::string& name) {
+    if (name == "scalable")
+        return SIconDirectory{.size = 128, .minSize = 8, .maxSize = 512, .type = ICON_DIR_SCALABLE};
+
+    auto x  = name.find('x');
+    auto at = name.find('@');
+    if (x == std::string::npos || x == 0 || x + 1 >= name.size())
+        return std::nullopt;
+
+    auto width  = name.substr(0, x);
+    auto height = name.substr(x + 1, at == std::string::npos ? std::string::npos : at - x - 1);
+    auto scale  = at == std::string::npos ? std::string("1") : name.substr(at + 1);
+    if (width != height || width.size() > 5 || !std::all_of(width.begin(), width.end(), ::isdigit) || scale.empty() || scale.size() > 2 ||
+        !std::all_of(scale.begin(), scale.end(), ::isdigit))
+        return std::nullopt;
+
+    const int size = std::stoi(width);
+    return SIconDirectory{.size = size, .minSize = size, .maxSize = size, .scale = std::max(1, std::stoi(scale))};
+}
+
+static std::string trim(const std::string& in) {
+    const auto first = in.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    return in.substr(first, in.find_last_not_of(" \t\r") - first + 1);
+}
+
+static std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream        ss(value);
+    std::string              item;
+    while (std::getline(ss, item, ',')) {
+        item = trim(item);
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+using IniSection = std::unordered_map<std::string, std::string>;
+
+static std::string iniValue(const IniSection& section, const char* key) {
+    auto it = section.find(key);
+    return it == section.end() ? std::string() : it->second;
+}
+
+static int iniInt(const IniSection& section, const char* key, int fallback) {
+    const auto value  = iniValue(section, key);
+    int        result = fallback;
+    std::from_chars(value.data(), value.data() + value.size(), result);
+    return result;
+}
+
+// Reads the [Icon Theme] header and the Applications sections it lists. Returns false if the file can't be read.
+static bool parseThemeIndex(const std::string& path, std::vector<SIconDirectory>& directories, std::vector<std::string>& inherits) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    std::unordered_map<std::string, IniSection> sections;
+    IniSection*                                 current = nullptr;
+    std::string                                 line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (line[0] == '[') {
+            current = &sections[line.substr(1, line.find(']') - 1)];
+            continue;
+        }
+
+        const auto eq = line.find('=');
+        if (current && eq != std::string::npos)
+            current->emplace(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+    }
+
+    const auto& header = sections["Icon Theme"];
+    inherits           = splitList(iniValue(header, "Inherits"));
+
+    auto names = splitList(iniValue(header, "Directories"));
+    for (auto& name : splitList(iniValue(header, "ScaledDirectories"))) {
+        if (std::find(names.begin(), names.end(), name) == names.end())
+            names.push_back(std::move(name));
+    }
+
+    for (uint32_t i = 0; i < names.size(); i++) {
+        auto it = sections.find(names[i]);
+        if (it == sections.end())
+            continue;
+
+        // only app icons are ever looked up; unlabeled dirs are kept since older themes omit Context
+        const auto& keys    = it->second;
+        const auto  context = iniValue(keys, "Context");
+        if (!context.empty() && context != "Applications")
+            continue;
+
+        SIconDirectory dir;
+        dir.path  = names[i];
+        dir.order = i;
+        dir.size  = iniInt(keys, "Size", 0);
+        if (dir.size <= 0)
+            continue;
+
+        const auto type = iniValue(keys, "Type");
+        dir.type        = type == "Fixed" ? ICON_DIR_FIXED : type == "Scalable" ? ICON_DIR_SCALABLE : ICON_DIR_THRESHOLD;
+        dir.scale       = std::max(1, iniInt(keys, "Scale", 1));
+        dir.minSize     = iniInt(keys, "MinSize", dir.size);
+        dir.maxSize     = iniInt(keys, "MaxSize", dir.size);
+        dir.threshold   = iniInt(keys, "Threshold", 2);
+        directories.push_back(std::move(dir));
+    }
+
+    return true;
+}
+
+// DirectoryMatchesSize from the icon theme spec
+static bool directoryMatchesSize(const SIconDirectory& dir, int size, int scale) {
+    if (dir.scale != scale)
+        return false;
+
+    switch (dir.type) {
+        case ICON_DIR_FIXED: return dir.size == size;
+        case ICON_DIR_SCALABLE: return dir.minSize <= size && size <= dir.maxSize;
+        case ICON_DIR_THRESHOLD: return dir.size - dir.threshold <= size && size <= dir.size + dir.threshold;
+    }
+    return false;
+}
+
+// DirectorySizeDistance from the icon theme spec, in device pixels
+static int directorySizeDistance(const SIconDirectory& dir, int size, int scale) {
+    const int target = size * scale;
+
+    switch (dir.type) {
+        case ICON_DIR_FIXED: return std::abs(dir.size * dir.scale - target);
+        case ICON_DIR_SCALABLE:
+            if (target < dir.minSize * dir.scale)
+                return dir.minSize * dir.scale - target;
+            if (target > dir.maxSize * dir.scale)
+                return target - dir.maxSize * dir.scale;
+            return 0;
+        case ICON_DIR_THRESHOLD:
+            if (target < (dir.size - dir.threshold) * dir.scale)
+                return (dir.size - dir.threshold) * dir.scale - target;
+            if (target > (dir.size + dir.threshold) * dir.scale)
+                return target - (dir.size + dir.threshold) * dir.scale;
+            return 0;
+    }
+    return 0;
+}
+
+// largest image the directory can provide without upscaling, in device pixels
+static int directoryPixelSize(const SIconDirectory& dir) {
+    return (dir.type == ICON_DIR_SCALABLE ? dir.maxSize : dir.size) * dir.scale;
+}
+
+void CIconThemeIndex::clear() {
+    m_themes.clear();
+    m_roots.clear();
+    m_directories.clear();
+    m_icons.clear();
+    m_pixmaps.clear();
+    m_pixmapsMtime = -1;
+}
+
+bool CIconThemeIndex::build(const std::vector<std::string>& basePaths, const std::string& theme, const std::string& pixmapsPath, CSnapshotReader* snapshot) {
+    clear();
+
+    // flattened once here, so lookups just walk m_themes in order
+    addTheme(basePaths, theme);
+    addTheme(basePaths, "hicolor");
+
+    std::unordered_map<std::string_view, CSnapshotReader> snapshotRoots;
+    CSnapshotReader                                       snapshotPixmaps;
+    if (snapshot) {
+        const uint32_t rootCount = snapshot->u32();
+        for (uint32_t i = 0; i < rootCount && !snapshot->failed(); i++) {
+            auto root = snapshot->section();
+            auto path = root.str();
+            if (!root.failed())
+                snapshotRoots.emplace(path, root);
+        }
+        snapshotPixmaps = snapshot->section();
+    }
+
+    bool rebuilt = false;
+
+    for (uint32_t t = 0; t < m_themes.size(); t++) {
+        for (uint32_t b = 0; b < basePaths.size(); b++) {
+            std::string themePath = basePaths[b] + "/" + m_themes[t].name;
+            if (!fs::is_directory(themePath))
+                continue;
+
+            m_roots.push_back({themePath, t, b, {}, nullptr, {}});
+
+            if (openCache(m_roots.size() - 1))
+                continue;
+
+            auto it = snapshotRoots.find(themePath);
+            if (it != snapshotRoots.end() && importRoot(m_roots.size() - 1, it->second))
+                continue;
+
+            scanRoot(m_roots.size() - 1);
+            rebuilt = true;
+        }
+    }
+
+    m_pixmapsPath = pixmapsPath;
+    if (!snapshot || !importPixmaps(snapshotPixmaps)) {
+        scanPixmaps();
+        rebuilt = true;
+    }
+
+    return rebuilt;
+}
+
+void CIconThemeIndex::addTheme(const std::vector<std::string>& basePaths, const std::string& name) {
+    if (name.empty() || hasTheme(name))
+        return;
+
+    m_themes.push_back({name, "", {}});
+
+    // the first index.theme found describes the theme in every base path, like GTK does
+    std::vector<std::string> inherits;
+    for (const auto& base : basePaths) {
+        const auto path = base + "/" + name + "/index.theme";
+        if (parseThemeIndex(path, m_themes.back().directories, inherits)) {
+            m_themes.back().indexPath = path;
+            break;
+        }
+    }
+
+    for (const auto& parent : inherits) {
+        addTheme(basePaths, parent);
+    }
+}
+
+size_t CIconThemeIndex::cachedRootCount() const {
+    return std::count_if(m_roots.begin(), m_roots.end(), [](const auto& root) { return root.cache != nullptr; });
+}
+
+bool CIconThemeIndex::hasTheme(const std::string& name) const {
+    return std::find_if(m_themes.begin(), m_themes.end(), [&](const auto& theme) { return theme.name == name; }) != m_themes.end();
+}
+
+void CIconThemeIndex::scanPixmaps() {
+    m_pixmaps.clear();
+    m_pixmapsMtime = pathMtime(m_pixmapsPath);
+
+    try {
+        for (const auto& entry : fs::directory_iterator(m_pixmapsPath)) {
+            if (entry.is_directory())
+                continue;
+            m_pixmaps.insert(entry.path().filename().string());
+        }
+    } catch (const std::exception& e) {}
+}
+
+bool CIconThemeIndex::importPixmaps(CSnapshotReader& reader) {
+    if (reader.str() != m_pixmapsPath)
+        return false;
+
+    const int64_t mtime = reader.i64();
+    if (reader.failed() || mtime != pathMtime(m_pixmapsPath))
+        return false;
+
+    std::unordered_set<std::string> pixmaps;
+    const uint32_t                  count = reader.u32();
+    for (uint32_t i = 0; i < count && !reader.failed(); i++) {
+        pixmaps.emplace(reader.str());
+    }
+
+    if (reader.failed())
+        return false;
+
+    m_pixmaps      = std::move(pixmaps);
+    m_pixmapsMtime = mtime;
+    return true;
+}
+
+void CIconThemeIndex::scanRoot(uint32_t rootIdx) {
+    const std::string rootPath = m_roots[rootIdx].path;
+    const auto&       theme    = m_themes[m_roots[rootIdx].theme];
+    m_roots[rootIdx].watched.push_back({rootPath, pathMtime(rootPath)});
+
+    if (!theme.indexPath.empty()) {
+        // the directory metadata of every root comes from this file
+        m_roots[rootIdx].watched.push_back({theme.indexPath, pathMtime(theme.indexPath)});
+
+        for (const auto& dir : theme.directories) {
+            scanDirectory(rootPath + "/" + dir.path, rootIdx, dir);
+        }
+        return;
+    }
+
+    try {
+        for (const auto& entry : fs::directory_iterator(rootPath)) {
+            if (!entry.is_directory())
+                continue;
+
+            auto dir = directoryFromName(entry.path().filename().string());
+            if (!dir)
+                continue;
+
+            for (uint8_t s = 0; s < SUBDIRS.size(); s++) {
+                std::string path = entry.path().string();
+                if (SUBDIRS[s][0] != '\0')
+                    path += std::string("/") + SUBDIRS[s];
+                dir->order = s;
+                scanDirectory(path, rootIdx, *dir);
+            }
+        }
+    } catch (const std::exception& e) {}
+}
+
+bool CIconThemeIndex::openCache(uint32_t rootIdx) {
+    auto&       root  = m_roots[rootIdx];
+    const auto& theme = m_themes[root.theme];
+
+    // without an index.theme there's no metadata for the directories the cache names
+    if (theme.indexPath.empty())
+        return false;
+
+    auto cache = CIconCache::open(root.path);
+    if (!cache)
+        return false;
+
+    std::unordered_map<std::string_view, uint32_t> cacheDirs;
+    for (uint32_t i = 0; i < cache->directoryCount(); i++) {
+        cacheDirs.emplace(cache->directory(i), i);
+    }
+
+    // directories the cache doesn't list hold no icons, so they're left out like empty ones would be
+    root.cacheDirs.assign(cache->directoryCount(), NO_DIRECTORY);
+    for (const auto& dir : theme.directories) {
+        auto it = cacheDirs.find(dir.path);
+        if (it == cacheDirs.end())
+            continue;
+
+        root.cacheDirs[it->second] = m_directories.size();
+        m_directories.push_back(dir);
+        m_directories.back().path = root.path + "/" + dir.path;
+        m_directories.back().root = rootIdx;
+    }
+
+    // regenerating the cache replaces the file, which is what changes the root's mtime
+    root.cache = std::move(cache);
+    root.watched.push_back({root.path, pathMtime(root.path)});
+    root.watched.push_back({theme.indexPath, pathMtime(theme.indexPath)});
+    return true;
+}
+
+void CIconThemeIndex::scanDirectory(const std::string& path, uint32_t rootIdx, SIconDirectory dir) {
+    // empty directories are kept too, so they can be rescanned in place once icons show up
+    const uint32_t dirIdx = m_directories.size();
+    dir.path              = path;
+    dir.root              = rootIdx;
+    m_directories.push_back(std::move(dir));
+
+    if (!fillDirectory(dirIdx)) {
+        m_directories.pop_back();
+        return;
+    }
+
+    // a missing subdir appearing later bumps the size dir's mtime, which is watched as the "" subdir
+    m_roots[rootIdx].watched.push_back({path, pathMtime(path)});
+}
+
+bool CIconThemeIndex::fillDirectory(uint32_t dirIdx) {
+    const auto& dir = m_directories[dirIdx];
+
+    std::vector<std::pair<std::string, eIconExtension>> found;
+
+    try {
+        for (const auto& entry : fs::directory_iterator(dir.path)) {
+            // the entry type is cached from readdir, so only symlinks would need a stat here
+            if (!entry.is_symlink() && entry.is_directory())
+                continue;
+
+            auto ext = extensionFromString(entry.path().extension().string());
+            if (!ext || (dir.type == ICON_DIR_SCALABLE && *ext != ICON_EXT_SVG))
+                continue;
+
+            found.emplace_back(entry.path().stem().string(), *ext);
+        }
+    } catch (const std::exception& e) { return false; }
+
+    for (auto& [name, ext] : found) {
+        m_icons[std::move(name)].push_back({dirIdx, ext});
+    }
+
+    return true;
+}
+
+bool CIconThemeIndex::rescanDirectory(const std::string& path) {
+    auto dirIt = std::find_if(m_directories.begin(), m_directories.end(), [&](const auto& dir) { return dir.path == path; });
+    if (dirIt == m_directories.end())
+        return false;
+
+    // cached directories are only ever refreshed with the whole cache
+    if (m_roots[dirIt->root].cache)
+        return false;
+
+    const uint32_t dirIdx = dirIt - m_directories.begin();
+
+    for (auto it = m_icons.begin(); it != m_icons.end();) {
+        auto& candidates = it->second;
+        std::erase_if(candidates, [dirIdx](const auto& candidate) { return candidate.directory == dirIdx; });
+        if (candidates.empty())
+            it = m_icons.erase(it);
+        else
+            ++it;
+    }
+
+    fillDirectory(dirIdx);
+
+    for (auto& watched : m_roots[dirIt->root].watched) {
+        if (watched.path == path)
+            watched.mtime = pathMtime(path);
+    }
+
+    return true;
+}
+
+void CIconThemeIndex::rescanPixmaps() {
+    scanPixmaps();
+}
+
+std::vector<std::string> CIconThemeIndex::watchedDirectories() const {
+    std::vector<std::string> dirs;
+    for (const auto& root : m_roots) {
+        for (const auto& watched : root.watched) {
+            dirs.push_back(watched.path);
+        }
+    }
+
+    if (!m_pixmapsPath.empty())
+        dirs.push_back(m_pixmapsPath);
+
+    return dirs;
+}
+
+bool CIconThemeIndex::importRoot(uint32_t rootIdx, CSnapshotReader& reader) {
+    std::vector<SWatchedDir> watched;
+    const uint32_t           watchedCount = reader.u32();
+    for (uint32_t i = 0; i < watchedCount && !reader.failed(); i++) {
+        SWatchedDir dir;
+        dir.path  = reader.str();
+        dir.mtime = reader.i64();
+        if (reader.failed() || pathMtime(dir.path) != dir.mtime)
+            return false;
+        watched.push_back(std::move(dir));
+    }
+
+    std::vector<SIconDirectory> directories;
+    const uint32_t              dirCount = reader.u32();
+    for (uint32_t i = 0; i < dirCount && !reader.failed(); i++) {
+        SIconDirectory dir;
+        dir.path      = reader.str();
+        dir.root      = rootIdx;
+        dir.order     = reader.u32();
+        dir.size      = reader.u32();
+        dir.minSize   = reader.u32();
+        dir.maxSize   = reader.u32();
+        dir.threshold = reader.u32();
+        dir.scale     = reader.u32();
+        const uint8_t type = reader.u8();
+        if (type > ICON_DIR_THRESHOLD)
+            return false;
+        dir.type = (eIconDirType)type;
+        directories.push_back(std::move(dir));
+    }
+
+    const uint32_t                                           dirBase = m_directories.size();
+    std::vector<std::pair<std::string_view, SIconCandidate>> candidates;
+    const uint32_t                                           iconCount = reader.u32();
+    for (uint32_t i = 0; i < iconCount && !reader.failed(); i++) {
+        const auto     name  = reader.str();
+        const uint32_t count = reader.u32();
+        for (uint32_t c = 0; c < count && !reader.failed(); c++) {
+            const uint32_t dir = reader.u32();
+            const uint8_t  ext = reader.u8();
+            if (dir >= directories.size() || ext > ICON_EXT_XPM)
+                return false;
+            candidates.push_back({name, {dirBase + dir, (eIconExtension)ext}});
+        }
+    }
+
+    if (reader.failed())
+        return false;
+
+    m_roots[rootIdx].watched = std::move(watched);
+    std::move(directories.begin(), directories.end(), std::back_inserter(m_directories));
+    m_icons.reserve(m_icons.size() + iconCount);
+    for (const auto& [name, candidate] : candidates) {
+        m_icons[std::string(name)].push_back(candidate);
+    }
+
+    return true;
+}
+
+void CIconThemeIndex::serialize(CSnapshotWriter& writer) const {
+    // candidates grouped per root, with directory indices made root-local
+    std::vector<std::vector<uint32_t>>                                                rootDirs(m_roots.size());
+    std::vector<uint32_t>                                                             localDir(m_directories.size());
+    std::vector<std::unordered_map<const std::string*, std::vector<SIconCandidate>>> rootIcons(m_roots.size());
+
+    for (uint32_t i = 0; i < m_directories.size(); i++) {
+        auto& dirs  = rootDirs[m_directories[i].root];
+        localDir[i] = dirs.size();
+        dirs.push_back(i);
+    }
+
+    for (const auto& [name, candidates] : m_icons) {
+        for (const auto& candidate : candidates) {
+            rootIcons[m_directories[candidate.directory].root][&name].push_back({localDir[candidate.directory], candidate.extension});
+        }
+    }
+
+    // cached roots are reopened from their icon-theme.cache, which is cheaper than any snapshot
+    writer.u32(std::count_if(m_roots.begin(), m_roots.end(), [](const auto& root) { return !root.cache; }));
+    for (uint32_t r = 0; r < m_roots.size(); r++) {
+        if (m_roots[r].cache)
+            continue;
+
+        const auto section = writer.beginSection();
+        writer.str(m_roots[r].path);
+
+        writer.u32(m_roots[r].watched.size());
+        for (const auto& dir : m_roots[r].watched) {
+            writer.str(dir.path);
+            writer.i64(dir.mtime);
+        }
+
+        writer.u32(rootDirs[r].size());
+        for (const auto d : rootDirs[r]) {
+            const auto& dir = m_directories[d];
+            writer.str(dir.path);
+            writer.u32(dir.order);
+            writer.u32(dir.size);
+            writer.u32(dir.minSize);
+            writer.u32(dir.maxSize);
+            writer.u32(dir.threshold);
+            writer.u32(dir.scale);
+            writer.u8(dir.type);
+        }
+
+        writer.u32(rootIcons[r].size());
+        for (const auto& [name, candidates] : rootIcons[r]) {
+            writer.str(*name);
+            writer.u32(candidates.size());
+            for (const auto& candidate : candidates) {
+                writer.u32(candidate.directory);
+                writer.u8(candidate.extension);
+            }
+        }
+
+        writer.endSection(section);
+    }
+
+    const auto section = writer.beginSection();
+    writer.str(m_pixmapsPath);
+    writer.i64(m_pixmapsMtime);
+    writer.u32(m_pixmaps.size());
+    for (const auto& name : m_pixmaps) {
+        writer.str(name);
+    }
+    writer.endSection(section);
+}
+
+std::string CIconThemeIndex::candidatePath(const std::string& iconName, const SIconCandidate& candidate) const {
+    return m_directories[candidate.directory].path + "/" + iconName + EXTENSIONS[candidate.extension];
+}
+
+std::optional<std::string> CIconThemeIndex::findIcon(const std::string& iconName, int size, int scale) const {
+    const int target = size * scale;
+
+    // The spec's lookup: the first theme in the chain that has the icon at all, a directory matching
+    // size and scale before the closest one, then directory order, base path and extension. Two
+    // refinements: bitmaps made for the size beat scalable dirs, and without a match the smallest
+    // directory still at least as large as the target wins, so nothing huge is decoded only to be shrunk.
+    using Rank = std::tuple<uint32_t, bool, bool, int, uint32_t, uint32_t, int>;
+    std::optional<Rank>           bestRank;
+    std::optional<SIconCandidate> best;
+
+    auto                          consider = [&](const SIconCandidate& candidate) {
+        const auto& dir     = m_directories[candidate.directory];
+        const auto& root    = m_roots[dir.root];
+        const bool  matches = directoryMatchesSize(dir, size, scale);
+
+        Rank        rank = {root.theme,
+                            !matches,
+                            matches ? dir.type == ICON_DIR_SCALABLE : directoryPixelSize(dir) < target,
+                            matches ? 0 : directorySizeDistance(dir, size, scale),
+                            dir.order,
+                            root.basePath,
+                            EXTENSION_RANK[candidate.extension]};
+        if (!bestRank || rank < *bestRank) {
+            bestRank = rank;
+            best     = candidate;
+        }
+    };
+
+    auto it = m_icons.find(iconName);
+    if (it != m_icons.end()) {
+        for (const auto& candidate : it->second) {
+            consider(candidate);
+        }
+    }
+
+    for (const auto& root : m_roots) {
+        if (!root.cache)
+            continue;
+
+        root.cache->forEachImage(iconName, [&](const SIconCacheImage& image) {
+            if (image.directory >= root.cacheDirs.size() || root.cacheDirs[image.directory] == NO_DIRECTORY)
+                return;
+
+            const uint32_t dirIdx = root.cacheDirs[image.directory];
+            if (image.flags & ICON_CACHE_SVG)
+                consider({dirIdx, ICON_EXT_SVG});
+            if (m_directories[dirIdx].type == ICON_DIR_SCALABLE)
+                return;
+            if (image.flags & ICON_CACHE_PNG)
+                consider({dirIdx, ICON_EXT_PNG});
+            if (image.flags & ICON_CACHE_XPM)
+                consider({dirIdx, ICON_EXT_XPM});
+        });
+    }
+
+    if (!best)
+        return std::nullopt;
+
+    return candidatePath(iconName, *best);
+}
+
+std::optional<std::string> CIconThemeIndex::findInPixmaps(const std::string& iconName) const {
+    for (const auto& ext : {".svg", ".png", ".xpm", ""}) {
+        if (m_pixmaps.contains(iconName + ext))
+            return m_pixmapsPath + "/" + iconName + ext;
+    }
+
+    return std::nullopt;
+}
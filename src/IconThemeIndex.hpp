@@ -0,0 +1,119 @@
+#pragma once
+
+#include "IconCache.hpp"
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+class CSnapshotReader;
+class CSnapshotWriter;
+
+enum eIconExtension : uint8_t {
+    ICON_EXT_SVG = 0,
+    ICON_EXT_PNG,
+    ICON_EXT_XPM,
+};
+
+enum eIconDirType : uint8_t {
+    ICON_DIR_FIXED = 0,
+    ICON_DIR_SCALABLE,
+    ICON_DIR_THRESHOLD,
+};
+
+// One subdirectory of a theme, with the metadata its index.theme section declares.
+struct SIconDirectory {
+    std::string  path;
+    uint32_t     root      = 0;
+    uint32_t     order     = 0; // position in the theme's Directories list
+    int          size      = 0;
+    int          minSize   = 0;
+    int          maxSize   = 0;
+    int          threshold = 2;
+    int          scale     = 1;
+    eIconDirType type      = ICON_DIR_THRESHOLD;
+};
+
+struct SIconCandidate {
+    uint32_t       directory = 0;
+    eIconExtension extension = ICON_EXT_SVG;
+};
+
+// Scans icon theme trees once so lookups resolve from memory instead of probing the filesystem.
+// Theme roots with a valid icon-theme.cache aren't scanned at all, their icons are looked up in the
+// mapped cache.
+class CIconThemeIndex {
+  public:
+    // Indexes the theme, everything it inherits and hicolor. Roots with a valid icon-theme.cache use
+    // it, roots found valid in the snapshot are imported as-is, the rest are rescanned. Returns true
+    // if anything had to be scanned.
+    bool build(const std::vector<std::string>& basePaths, const std::string& theme, const std::string& pixmapsPath, CSnapshotReader* snapshot = nullptr);
+    void clear();
+
+    void serialize(CSnapshotWriter& writer) const;
+
+    // Re-reads a single icon directory after it changed on disk. Returns false if the path isn't
+    // one of the indexed leaf directories, in which case the caller should rebuild.
+    bool rescanDirectory(const std::string& path);
+    void rescanPixmaps();
+    bool isPixmapsDirectory(const std::string& path) const { return path == m_pixmapsPath; }
+
+    // every directory (and index.theme) whose contents the index depends on
+    std::vector<std::string> watchedDirectories() const;
+
+    // whether the theme is part of the inherits chain, installed or not
+    bool hasTheme(const std::string& name) const;
+
+    // best fit for size logical pixels at an integer buffer scale, searching the inherits chain in order
+    std::optional<std::string> findIcon(const std::string& iconName, int size, int scale = 1) const;
+    std::optional<std::string> findInPixmaps(const std::string& iconName) const;
+
+    size_t iconCount() const { return m_icons.size(); }
+    size_t directoryCount() const { return m_directories.size(); }
+    size_t cachedRootCount() const;
+
+  private:
+    struct SWatchedDir {
+        std::string path;
+        int64_t     mtime = -1;
+    };
+
+    struct STheme {
+        std::string                 name;
+        std::string                 indexPath;
+        std::vector<SIconDirectory> directories; // paths relative to the theme root
+    };
+
+    struct SRoot {
+        std::string                 path;
+        uint32_t                    theme    = 0;
+        uint32_t                    basePath = 0;
+        std::vector<SWatchedDir>    watched;
+        std::unique_ptr<CIconCache> cache;
+        std::vector<uint32_t>       cacheDirs; // cache directory index -> m_directories, NO_DIRECTORY if not indexed
+    };
+
+    static constexpr uint32_t NO_DIRECTORY = UINT32_MAX;
+
+    void        addTheme(const std::vector<std::string>& basePaths, const std::string& name);
+    void        scanRoot(uint32_t rootIdx);
+    bool        openCache(uint32_t rootIdx);
+    void        scanDirectory(const std::string& path, uint32_t rootIdx, SIconDirectory dir);
+    bool        fillDirectory(uint32_t dirIdx);
+    bool        importRoot(uint32_t rootIdx, CSnapshotReader& reader);
+    void        scanPixmaps();
+    bool        importPixmaps(CSnapshotReader& reader);
+    std::string candidatePath(const std::string& iconName, const SIconCandidate& candidate) const;
+
+    std::vector<STheme>                                          m_themes;
+    std::vector<SRoot>                                           m_roots;
+    std::vector<SIconDirectory>                                  m_directories;
+    std::unordered_map<std::string, std::vector<SIconCandidate>> m_icons;
+    std::string                                                  m_pixmapsPath;
+    int64_t                                                      m_pixmapsMtime = -1;
+    std::unordered_set<std::string>                              m_pixmaps;
+};
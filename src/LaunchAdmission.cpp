@@ -0,0 +1,110 @@
+#include "LaunchAdmission.hpp"
+
+#include <algorithm>
+
+// classes remembered for coalescing before stale ones are swept
+constexpr size_t MAX_REMEMBERED = 256;
+
+void CLaunchAdmission::configure(const SAdmissionConfig& config) {
+    m_config             = config;
+    m_config.maxOverlays = std::max<size_t>(1, m_config.maxOverlays);
+    m_config.maxQueued   = std::max<size_t>(1, m_config.maxQueued);
+    m_config.burst       = std::max(1.0, m_config.burst);
+    m_config.rate        = std::max(0.0, m_config.rate);
+    m_tokens             = std::min(m_tokens, m_config.burst);
+
+    while (m_queue.size() > m_config.maxQueued) {
+        dropOldest();
+    }
+}
+
+// the dropped launch never showed, so the next open of its class mustn't be coalesced into it
+void CLaunchAdmission::dropOldest() {
+    const auto& request = m_queue.front();
+    if (auto last = m_lastOpen.find(request.appClass); last != m_lastOpen.end() && last->second == request.time)
+        m_lastOpen.erase(last);
+
+    m_queue.pop_front();
+    m_stats.dropped++;
+}
+
+bool CLaunchAdmission::offer(SLaunchRequest request) {
+    m_stats.offered++;
+
+    const auto WINDOW = std::chrono::milliseconds(m_config.coalesceMs);
+    auto       last   = m_lastOpen.find(request.appClass);
+    if (last != m_lastOpen.end() && request.time - last->second < WINDOW) {
+        m_stats.coalesced++;
+        return false;
+    }
+
+    if (m_queue.size() >= m_config.maxQueued) {
+        if (m_config.drop == ADMISSION_DROP_NEWEST || m_queue.empty()) {
+            m_stats.dropped++;
+            return false;
+        }
+        dropOldest();
+        last = m_lastOpen.find(request.appClass);
+    }
+
+    // only a queued request starts a coalescing window, a dropped one must not swallow the next open
+    if (last != m_lastOpen.end())
+        last->second = request.time;
+    else {
+        if (m_lastOpen.size() >= MAX_REMEMBERED)
+            std::erase_if(m_lastOpen, [&](const auto& entry) { return request.time - entry.second >= WINDOW; });
+        m_lastOpen.emplace(request.appClass, request.time);
+    }
+
+    m_queue.push_back(std::move(request));
+    return true;
+}
+
+void CLaunchAdmission::refill(Clock::time_point now) {
+    if (m_refilled == Clock::time_point{} || m_config.rate <= 0.0) {
+        m_tokens   = m_config.burst;
+        m_refilled = now;
+        return;
+    }
+
+    const double elapsed = std::chrono::duration<double>(now - m_refilled).count();
+    m_tokens             = std::min(m_config.burst, m_tokens + std::max(0.0, elapsed) * m_config.rate);
+    m_refilled           = now;
+}
+
+std::vector<SLaunchRequest> CLaunchAdmission::admit(Clock::time_point now, size_t activeOverlays) {
+    refill(now);
+
+    // an icon showing up this late no longer belongs to the launch
+    const auto MAXWAIT = std::chrono::milliseconds(m_config.maxWaitMs);
+    while (!m_queue.empty() && now - m_queue.front().time > MAXWAIT) {
+        dropOldest();
+    }
+
+    std::vector<SLaunchRequest> admitted;
+    while (!m_queue.empty() && m_tokens >= 1.0 && activeOverlays < m_config.maxOverlays) {
+        admitted.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+        if (m_config.rate > 0.0)
+            m_tokens -= 1.0;
+        activeOverlays++;
+    }
+
+    m_stats.admitted += admitted.size();
+    return admitted;
+}
+
+std::optional<CLaunchAdmission::Clock::duration> CLaunchAdmission::nextAdmission(Clock::time_point now, size_t activeOverlays) const {
+    if (m_queue.empty() || activeOverlays >= m_config.maxOverlays)
+        return std::nullopt;
+
+    if (m_tokens >= 1.0 || m_config.rate <= 0.0)
+        return Clock::duration::zero();
+
+    const double elapsed = std::chrono::duration<double>(now - m_refilled).count();
+    const double missing = 1.0 - m_tokens - std::max(0.0, elapsed) * m_config.rate;
+    if (missing <= 0.0)
+        return Clock::duration::zero();
+
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(missing / m_config.rate));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// which request gives way when the queue is full
+enum eAdmissionDrop {
+    ADMISSION_DROP_NEWEST, // the one arriving
+    ADMISSION_DROP_OLDEST  // the longest waiting, it is the most likely to show up late anyway
+};
+
+struct SAdmissionConfig {
+    size_t         maxOverlays = 8;  // on screen at once, loading or animating
+    size_t         maxQueued   = 16;
+    int            coalesceMs  = 1000; // opens of a class this soon after the last one are folded into it
+    int            maxWaitMs   = 500;  // queued longer than this and the window has been on screen for a while
+    double         rate        = 4.0;  // overlays started per second once the burst is spent, 0 for no limit
+    double         burst       = 4.0;
+    eAdmissionDrop drop        = ADMISSION_DROP_NEWEST;
+};
+
+struct SLaunchRequest {
+    std::string                           appClass;
+    int64_t                               monitorId = -1;
+    pid_t                                 pid       = 0; // of the window, for classes that find no icon
+    std::chrono::steady_clock::time_point time;
+};
+
+struct SAdmissionStats {
+    uint64_t offered   = 0;
+    uint64_t admitted  = 0;
+    uint64_t coalesced = 0;
+    uint64_t dropped   = 0; // queue full or waited too long
+};
+
+// Sits between openWindow and overlay creation so a storm of windows costs a bounded amount of
+// work: repeated opens of a class are coalesced, the rest wait in a bounded queue and start at
+// the pace of a token bucket, never more than maxOverlays at once. Compositor thread only.
+class CLaunchAdmission {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    void                         configure(const SAdmissionConfig& config);
+
+    // false when the request was coalesced or dropped right away
+    bool                         offer(SLaunchRequest request);
+
+    // the requests that may start now, with activeOverlays already on screen
+    std::vector<SLaunchRequest>  admit(Clock::time_point now, size_t activeOverlays);
+
+    // how long until admit() has something to hand out, nullopt when it is waiting on the queue
+    // to fill or on overlays to finish
+    std::optional<Clock::duration> nextAdmission(Clock::time_point now, size_t activeOverlays) const;
+
+    size_t                       queued() const { return m_queue.size(); }
+    const SAdmissionStats&       stats() const { return m_stats; }
+
+  private:
+    void                                               refill(Clock::time_point now);
+    void                                               dropOldest();
+
+    SAdmissionConfig                                   m_config;
+    std::deque<SLaunchRequest>                         m_queue;
+    std::unordered_map<std::string, Clock::time_point> m_lastOpen;
+    double                                             m_tokens = 4.0;
+    Clock::time_point                                  m_refilled;
+    SAdmissionStats                                    m_stats;
+};
@@ -0,0 +1,91 @@
+#include "LaunchHistory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <tuple>
+
+std::string CLaunchHistory::path() {
+    return cachePath("launches.bin");
+}
+
+void CLaunchHistory::load() {
+    CSnapshotFile file;
+    if (!file.open(path(), LAUNCH_HISTORY_MAGIC, LAUNCH_HISTORY_VERSION))
+        return;
+
+    auto           reader = file.reader();
+    const uint32_t COUNT  = reader.u32();
+
+    std::unordered_map<std::string, SEntry> entries;
+    for (uint32_t i = 0; i < COUNT && !reader.failed(); i++) {
+        std::string iconName{reader.str()};
+        SEntry      entry;
+        entry.launches   = reader.u32();
+        entry.lastLaunch = reader.i64();
+
+        if (!iconName.empty())
+            entries[iconName] = entry;
+    }
+
+    if (!reader.failed())
+        m_entries = std::move(entries);
+}
+
+void CLaunchHistory::record(const std::string& iconName) {
+    m_dirty     = true;
+    auto& entry = m_entries[iconName];
+    entry.launches++;
+    entry.lastLaunch = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if (m_entries.size() <= MAX_ENTRIES)
+        return;
+
+    // forget the least used app to keep the table small
+    auto worst = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->first == iconName)
+            continue;
+        if (worst == m_entries.end() || std::tie(it->second.launches, it->second.lastLaunch) < std::tie(worst->second.launches, worst->second.lastLaunch))
+            worst = it;
+    }
+
+    if (worst != m_entries.end())
+        m_entries.erase(worst);
+}
+
+std::vector<std::string> CLaunchHistory::top(size_t count) const {
+    std::vector<std::pair<std::string, SEntry>> sorted(m_entries.begin(), m_entries.end());
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.second.launches, a.second.lastLaunch) > std::tie(b.second.launches, b.second.lastLaunch);
+    });
+
+    std::vector<std::string> result;
+    for (size_t i = 0; i < sorted.size() && i < count; i++) {
+        result.push_back(sorted[i].first);
+    }
+
+    return result;
+}
+
+CSnapshotWriter CLaunchHistory::serialize() const {
+    CSnapshotWriter writer;
+    writer.u32(m_entries.size());
+
+    for (const auto& [iconName, entry] : m_entries) {
+        writer.str(iconName);
+        writer.u32(entry.launches);
+        writer.i64(entry.lastLaunch);
+    }
+
+    return writer;
+}
+
+bool CLaunchHistory::write(CSnapshotWriter& writer) {
+    // two launches in quick succession would otherwise share the temporary file
+    static std::mutex writeMutex;
+    std::lock_guard   lock(writeMutex);
+
+    return writer.commit(path(), LAUNCH_HISTORY_MAGIC, LAUNCH_HISTORY_VERSION);
+}
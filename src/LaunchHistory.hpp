@@ -0,0 +1,44 @@
+#pragma once
+
+#include "LookupSnapshot.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t LAUNCH_HISTORY_MAGIC   = 0x4c495948; // "HYIL"
+constexpr uint32_t LAUNCH_HISTORY_VERSION = 2;
+
+// How often each app was launched, persisted in $XDG_CACHE_HOME/hypricons/launches.bin so the
+// icons used most can be warmed up after login. Apps are keyed by the icon name their class
+// resolves to (see CIconLookup::iconName), so every class of one app counts together.
+// Compositor thread only.
+class CLaunchHistory {
+  public:
+    void                     load();
+    void                     record(const std::string& iconName);
+
+    // most launched first, ties broken by the most recent launch
+    std::vector<std::string> top(size_t count) const;
+
+    // whether launches were recorded since load()
+    bool                     dirty() const { return m_dirty; }
+
+    // a copy of the table, handed to write() on a worker so launches never wait on disk
+    CSnapshotWriter          serialize() const;
+    static bool              write(CSnapshotWriter& writer);
+
+    static std::string       path();
+
+  private:
+    struct SEntry {
+        uint32_t launches   = 0;
+        int64_t  lastLaunch = 0; // seconds since epoch
+    };
+
+    static constexpr size_t                 MAX_ENTRIES = 256;
+
+    std::unordered_map<std::string, SEntry> m_entries;
+    bool                                    m_dirty = false;
+};
@@ -0,0 +1,203 @@
+#include "LaunchTrace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static uint64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SLaunchTrace::mark(eTraceStage stage) {
+    if (g_launchTracer.enabled())
+        ns[stage] = monotonicNs();
+}
+
+void SLaunchTrace::merge(const SLaunchTrace& other) {
+    for (size_t i = 0; i < ns.size(); i++) {
+        if (other.ns[i])
+            ns[i] = other.ns[i];
+    }
+}
+
+void CLaunchTracer::SHistogram::add(uint64_t ns) {
+    const uint64_t us     = ns / 1000;
+    const size_t   bucket = us < 2 ? 0 : std::min<size_t>(std::bit_width(us) - 1, buckets.size() - 1);
+
+    buckets[bucket]++;
+    count++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+uint64_t CLaunchTracer::SHistogram::percentileUs(double p) const {
+    if (!count)
+        return 0;
+
+    // upper edge of the bucket holding the percentile, so never optimistic
+    const uint64_t target = std::max<uint64_t>(1, p * count + 0.5);
+    uint64_t       seen   = 0;
+    for (size_t b = 0; b < buckets.size(); b++) {
+        seen += buckets[b];
+        if (seen >= target)
+            return std::min<uint64_t>(2ULL << b, maxNs / 1000 + 1);
+    }
+
+    return maxNs / 1000;
+}
+
+const char* CLaunchTracer::intervalName(size_t interval) {
+    static constexpr std::array<const char*, INTERVAL_COUNT> NAMES = {
+        "resolve queue", "resolve", "raster queue", "decode", "render", "convert", "upload queue", "upload", "first frame", "total",
+    };
+    return interval < NAMES.size() ? NAMES[interval] : "?";
+}
+
+CLaunchTracer::~CLaunchTracer() {
+    if (m_dumpFd >= 0)
+        close(m_dumpFd);
+}
+
+void CLaunchTracer::setEnabled(bool enabled) {
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void CLaunchTracer::setDumpPath(const std::string& path) {
+    std::lock_guard lock(m_mutex);
+    if (path == m_dumpPath)
+        return;
+
+    if (m_dumpFd >= 0)
+        close(m_dumpFd);
+
+    m_dumpPath = path;
+    m_dumpFd   = -1;
+    if (path.empty())
+        return;
+
+    m_dumpFd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    // JSON array format; the viewers accept a missing closing bracket and a trailing comma,
+    // so events can be appended as launches finish
+    struct stat st;
+    if (m_dumpFd >= 0 && fstat(m_dumpFd, &st) == 0 && st.st_size == 0)
+        (void)!write(m_dumpFd, "[\n", 2);
+}
+
+void CLaunchTracer::record(const SLaunchTrace& trace, const std::string& appClass) {
+    if (!enabled() || !trace.ns[TRACE_LAUNCH])
+        return;
+
+    std::lock_guard lock(m_mutex);
+
+    uint64_t previous = trace.ns[TRACE_LAUNCH];
+    uint64_t last     = previous;
+    for (size_t stage = 1; stage < TRACE_STAGE_COUNT; stage++) {
+        // skipped stages (cache hits) fold into the next one that ran
+        if (!trace.ns[stage] || trace.ns[stage] < previous)
+            continue;
+        m_histograms[stage - 1].add(trace.ns[stage] - previous);
+        previous = last = trace.ns[stage];
+    }
+    m_histograms[INTERVAL_COUNT - 1].add(last - trace.ns[TRACE_LAUNCH]);
+    m_launches++;
+
+    if (m_dumpFd >= 0)
+        appendEvents(trace, appClass);
+}
+
+void CLaunchTracer::recordCancelled() {
+    if (!enabled())
+        return;
+
+    std::lock_guard lock(m_mutex);
+    m_cancelled++;
+}
+
+void CLaunchTracer::reset() {
+    std::lock_guard lock(m_mutex);
+    m_histograms = {};
+    m_cancelled  = 0;
+    m_launches   = 0;
+}
+
+std::array<CLaunchTracer::SHistogram, CLaunchTracer::INTERVAL_COUNT> CLaunchTracer::histograms() {
+    std::lock_guard lock(m_mutex);
+    return m_histograms;
+}
+
+uint64_t CLaunchTracer::cancelled() {
+    std::lock_guard lock(m_mutex);
+    return m_cancelled;
+}
+
+std::string CLaunchTracer::summary() {
+    std::lock_guard lock(m_mutex);
+
+    std::string result;
+    char        line[128];
+    snprintf(line, sizeof(line), "%lu launches traced, %lu skipped\n%-14s %8s %10s %10s %10s %10s\n", (unsigned long)m_launches, (unsigned long)m_cancelled, "interval",
+             "count", "mean us", "p50 us", "p99 us", "max us");
+    result += line;
+
+    for (size_t i = 0; i < INTERVAL_COUNT; i++) {
+        const auto& h = m_histograms[i];
+        if (!h.count)
+            continue;
+        snprintf(line, sizeof(line), "%-14s %8lu %10lu %10lu %10lu %10lu\n", intervalName(i), (unsigned long)h.count, (unsigned long)(h.totalNs / h.count / 1000),
+                 (unsigned long)h.percentileUs(0.5), (unsigned long)h.percentileUs(0.99), (unsigned long)(h.maxNs / 1000));
+        result += line;
+    }
+
+    return result;
+}
+
+std::string jsonEscape(const std::string& in) {
+    std::string out;
+    for (char c : in) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else
+            out += c;
+    }
+    return out;
+}
+
+void CLaunchTracer::appendEvents(const SLaunchTrace& trace, const std::string& appClass) {
+    // one row per launch, one complete event per interval
+    const int      pid = getpid();
+    const uint64_t tid = m_launches;
+
+    // cut before escaping so no escape sequence is split, and on a UTF-8 boundary
+    size_t nameLen = std::min<size_t>(appClass.size(), 128);
+    while (nameLen > 0 && nameLen < appClass.size() && ((unsigned char)appClass[nameLen] & 0xC0) == 0x80) {
+        nameLen--;
+    }
+
+    std::string events = "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid) + ",\"args\":{\"name\":\"" +
+        jsonEscape(appClass.substr(0, nameLen)) + "\"}},\n";
+
+    // only numbers and fixed interval names from here on
+    char     line[256];
+    uint64_t previous = trace.ns[TRACE_LAUNCH];
+    for (size_t stage = 1; stage < TRACE_STAGE_COUNT; stage++) {
+        if (!trace.ns[stage] || trace.ns[stage] < previous)
+            continue;
+        snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"hypricons\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f},\n", intervalName(stage - 1), pid,
+                 (unsigned long)tid, previous / 1000.0, (trace.ns[stage] - previous) / 1000.0);
+        events += line;
+        previous = trace.ns[stage];
+    }
+
+    // a single O_APPEND write per launch, only while a dump is configured
+    (void)!write(m_dumpFd, events.data(), events.size());
+}
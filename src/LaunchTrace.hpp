@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Stages of a launch, from openWindow to the first frame that shows the icon, in pipeline order.
+enum eTraceStage : uint8_t {
+    TRACE_LAUNCH = 0,
+    TRACE_RESOLVE_START,
+    TRACE_RESOLVE_END,
+    TRACE_RASTER_START,
+    TRACE_DECODE_END,
+    TRACE_RENDER_END,
+    TRACE_CONVERT_END,
+    TRACE_UPLOAD_START,
+    TRACE_UPLOAD_END,
+    TRACE_FIRST_FRAME,
+    TRACE_STAGE_COUNT,
+};
+
+// Monotonic timestamps of one launch. Worker threads fill their own copy and hand it back with
+// their completion, the compositor thread merges it into the overlay's.
+struct SLaunchTrace {
+    std::array<uint64_t, TRACE_STAGE_COUNT> ns{};
+
+    void                                    mark(eTraceStage stage);
+    void                                    merge(const SLaunchTrace& other);
+};
+
+// Per-interval latency histograms, plus an optional Chrome trace-event dump (chrome://tracing,
+// ui.perfetto.dev). Marking costs a relaxed atomic load while disabled.
+class CLaunchTracer {
+  public:
+    ~CLaunchTracer();
+
+    bool        enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void        setEnabled(bool enabled);
+    void        setDumpPath(const std::string& path);
+
+    void        record(const SLaunchTrace& trace, const std::string& appClass);
+    void        recordCancelled();
+    void        reset();
+
+    std::string summary();
+
+    // intervals between consecutive stages, plus the whole launch
+    static constexpr size_t INTERVAL_COUNT = TRACE_STAGE_COUNT;
+    static const char*      intervalName(size_t interval);
+
+    struct SHistogram {
+        // bucket b counts durations in [2^b, 2^(b+1)) microseconds, the first also takes anything shorter
+        std::array<uint32_t, 24> buckets{};
+        uint64_t                 count   = 0;
+        uint64_t                 totalNs = 0;
+        uint64_t                 maxNs   = 0;
+
+        void                     add(uint64_t ns);
+        uint64_t                 percentileUs(double p) const;
+    };
+
+    std::array<SHistogram, INTERVAL_COUNT> histograms();
+    uint64_t                               cancelled();
+
+  private:
+    void                                   appendEvents(const SLaunchTrace& trace, const std::string& appClass);
+
+    std::atomic<bool>                      m_enabled = false;
+    std::mutex                             m_mutex;
+    std::array<SHistogram, INTERVAL_COUNT> m_histograms;
+    uint64_t                               m_cancelled = 0;
+    uint64_t                               m_launches  = 0;
+    std::string                            m_dumpPath;
+    int                                    m_dumpFd = -1;
+};
+
+inline CLaunchTracer g_launchTracer;
+
+// for the trace dump and the hyprctl command's JSON
+std::string jsonEscape(const std::string& in);
@@ -0,0 +1,196 @@
+#include "LookupSnapshot.hpp"
+
+#include <filesystem>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+std::string cachePath(const std::string& name) {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && cacheHome[0] == '/')
+        return std::string(cacheHome) + "/hypricons/" + name;
+
+    const char* home = std::getenv("HOME");
+    if (!home)
+        return "";
+
+    return std::string(home) + "/.cache/hypricons/" + name;
+}
+
+std::string snapshotPath() {
+    return cachePath("lookup.bin");
+}
+
+int64_t pathMtime(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return -1;
+
+    return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+void CSnapshotWriter::u8(uint8_t v) {
+    m_buffer.append((const char*)&v, sizeof(v));
+}
+
+void CSnapshotWriter::u32(uint32_t v) {
+    m_buffer.append((const char*)&v, sizeof(v));
+}
+
+void CSnapshotWriter::i64(int64_t v) {
+    m_buffer.append((const char*)&v, sizeof(v));
+}
+
+void CSnapshotWriter::str(std::string_view v) {
+    u32(v.size());
+    m_buffer.append(v);
+}
+
+size_t CSnapshotWriter::beginSection() {
+    const size_t pos = m_buffer.size();
+    u32(0);
+    return pos;
+}
+
+void CSnapshotWriter::endSection(size_t section) {
+    const uint32_t len = m_buffer.size() - section - sizeof(uint32_t);
+    std::memcpy(m_buffer.data() + section, &len, sizeof(len));
+}
+
+bool CSnapshotWriter::commit(const std::string& path, uint32_t magic, uint32_t version) {
+    if (path.empty())
+        return false;
+
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    const std::string tmpPath = path + ".tmp";
+    int               fd      = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    const uint32_t header[2] = {magic, version};
+    bool           ok        = write(fd, header, sizeof(header)) == sizeof(header);
+
+    size_t written = 0;
+    while (ok && written < m_buffer.size()) {
+        ssize_t n = write(fd, m_buffer.data() + written, m_buffer.size() - written);
+        if (n <= 0)
+            ok = false;
+        else
+            written += n;
+    }
+
+    close(fd);
+
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool CSnapshotReader::take(void* out, size_t len) {
+    if (m_failed || m_size - m_pos < len) {
+        m_failed = true;
+        return false;
+    }
+
+    std::memcpy(out, m_data + m_pos, len);
+    m_pos += len;
+    return true;
+}
+
+uint8_t CSnapshotReader::u8() {
+    uint8_t v = 0;
+    take(&v, sizeof(v));
+    return v;
+}
+
+uint32_t CSnapshotReader::u32() {
+    uint32_t v = 0;
+    take(&v, sizeof(v));
+    return v;
+}
+
+int64_t CSnapshotReader::i64() {
+    int64_t v = 0;
+    take(&v, sizeof(v));
+    return v;
+}
+
+std::string_view CSnapshotReader::str() {
+    const uint32_t len = u32();
+    if (m_failed || m_size - m_pos < len) {
+        m_failed = true;
+        return {};
+    }
+
+    std::string_view v((const char*)m_data + m_pos, len);
+    m_pos += len;
+    return v;
+}
+
+CSnapshotReader CSnapshotReader::section() {
+    const uint32_t len = u32();
+    if (m_failed || m_size - m_pos < len) {
+        m_failed = true;
+        CSnapshotReader failed;
+        failed.m_failed = true;
+        return failed;
+    }
+
+    CSnapshotReader sub(m_data + m_pos, len);
+    m_pos += len;
+    return sub;
+}
+
+CSnapshotFile::~CSnapshotFile() {
+    if (m_map)
+        munmap(m_map, m_size);
+}
+
+bool CSnapshotFile::open(const std::string& path, uint32_t magic, uint32_t version) {
+    if (path.empty())
+        return false;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(2 * sizeof(uint32_t))) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    uint32_t header[2];
+    std::memcpy(header, map, sizeof(header));
+    if (header[0] != magic || header[1] != version) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    m_map  = map;
+    m_size = st.st_size;
+    return true;
+}
+
+CSnapshotReader CSnapshotFile::reader() const {
+    if (!m_map)
+        return {};
+
+    return CSnapshotReader((const uint8_t*)m_map + 2 * sizeof(uint32_t), m_size - 2 * sizeof(uint32_t));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// On-disk snapshot of the resolved lookup state, stored in $XDG_CACHE_HOME/hypricons.
+// Every section is length-prefixed so a stale section can be skipped and rebuilt on its own.
+
+constexpr uint32_t SNAPSHOT_MAGIC   = 0x43495948; // "HYIC"
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+std::string cachePath(const std::string& name);
+std::string snapshotPath();
+int64_t     pathMtime(const std::string& path);
+
+class CSnapshotWriter {
+  public:
+    void u8(uint8_t v);
+    void u32(uint32_t v);
+    void i64(int64_t v);
+    void str(std::string_view v);
+
+    size_t beginSection();
+    void   endSection(size_t section);
+
+    bool   commit(const std::string& path, uint32_t magic = SNAPSHOT_MAGIC, uint32_t version = SNAPSHOT_VERSION);
+
+  private:
+    std::string m_buffer;
+};
+
+class CSnapshotReader {
+  public:
+    CSnapshotReader() = default;
+    CSnapshotReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    uint8_t          u8();
+    uint32_t         u32();
+    int64_t          i64();
+    std::string_view str();
+    CSnapshotReader  section();
+
+    bool             failed() const { return m_failed; }
+    bool             atEnd() const { return m_pos == m_size; }
+
+  private:
+    bool            take(void* out, size_t len);
+
+    const uint8_t* m_data   = nullptr;
+    size_t         m_size   = 0;
+    size_t         m_pos    = 0;
+    bool           m_failed = false;
+};
+
+// Read-only mapping of a snapshot file. Readers handed out point into the mapping.
+class CSnapshotFile {
+  public:
+    CSnapshotFile() = default;
+    ~CSnapshotFile();
+
+    CSnapshotFile(const CSnapshotFile&)            = delete;
+    CSnapshotFile& operator=(const CSnapshotFile&) = delete;
+
+    bool            open(const std::string& path, uint32_t magic = SNAPSHOT_MAGIC, uint32_t version = SNAPSHOT_VERSION);
+    CSnapshotReader reader() const;
+
+  private:
+    void*  m_map  = nullptr;
+    size_t m_size = 0;
+};
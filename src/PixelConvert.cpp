@@ -0,0 +1,207 @@
+#include "PixelConvert.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HYPRICONS_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HYPRICONS_NEON
+#endif
+
+// exact round(c * a / 255) without a division
+static inline uint8_t mulDiv255(uint32_t c, uint32_t a) {
+    const uint32_t t = c * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static void swizzleScalar(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint32_t p;
+        std::memcpy(&p, src + i * 4, 4);
+        p = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+        std::memcpy(dst + i * 4, &p, 4);
+    }
+}
+
+static void premultiplyScalar(uint8_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t*       p = pixels + i * 4;
+        const uint32_t a = p[3];
+        if (a == 255)
+            continue;
+        p[0] = mulDiv255(p[0], a);
+        p[1] = mulDiv255(p[1], a);
+        p[2] = mulDiv255(p[2], a);
+    }
+}
+
+#ifdef HYPRICONS_X86
+
+__attribute__((target("sse2"))) static void swizzleSSE2(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    const __m128i maskAG  = _mm_set1_epi32(0xFF00FF00);
+    const __m128i maskLow = _mm_set1_epi32(0x000000FF);
+
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const __m128i p  = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        const __m128i ag = _mm_and_si128(p, maskAG);
+        const __m128i r  = _mm_and_si128(_mm_srli_epi32(p, 16), maskLow);
+        const __m128i b  = _mm_slli_epi32(_mm_and_si128(p, maskLow), 16);
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(ag, _mm_or_si128(r, b)));
+    }
+
+    swizzleScalar(src + i * 4, dst + i * 4, pixels - i);
+}
+
+__attribute__((target("sse2"))) static __m128i premultiplyHalfSSE2(__m128i channels) {
+    __m128i alpha = _mm_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha         = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(channels, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("sse2"))) static void premultiplySSE2(uint8_t* pixels, size_t count) {
+    const __m128i zero      = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p  = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+        const __m128i lo = premultiplyHalfSSE2(_mm_unpacklo_epi8(p, zero));
+        const __m128i hi = premultiplyHalfSSE2(_mm_unpackhi_epi8(p, zero));
+        const __m128i r  = _mm_packus_epi16(lo, hi);
+        _mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_or_si128(_mm_andnot_si128(alphaMask, r), _mm_and_si128(alphaMask, p)));
+    }
+
+    premultiplyScalar(pixels + i * 4, count - i);
+}
+
+__attribute__((target("avx2"))) static void swizzleAVX2(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(p, shuffle));
+    }
+
+    swizzleScalar(src + i * 4, dst + i * 4, pixels - i);
+}
+
+__attribute__((target("avx2"))) static __m256i premultiplyHalfAVX2(__m256i channels) {
+    __m256i alpha = _mm256_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha         = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(channels, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2"))) static void premultiplyAVX2(uint8_t* pixels, size_t count) {
+    const __m256i zero      = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // unpack and pack both work per 128-bit lane, so the pixel order survives the round trip
+        const __m256i p  = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+        const __m256i lo = premultiplyHalfAVX2(_mm256_unpacklo_epi8(p, zero));
+        const __m256i hi = premultiplyHalfAVX2(_mm256_unpackhi_epi8(p, zero));
+        const __m256i r  = _mm256_packus_epi16(lo, hi);
+        _mm256_storeu_si256((__m256i*)(pixels + i * 4), _mm256_or_si256(_mm256_andnot_si256(alphaMask, r), _mm256_and_si256(alphaMask, p)));
+    }
+
+    premultiplyScalar(pixels + i * 4, count - i);
+}
+
+#endif
+
+#ifdef HYPRICONS_NEON
+
+static void swizzleNEON(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        uint8x16_t   r = p.val[0];
+        p.val[0]       = p.val[2];
+        p.val[2]       = r;
+        vst4q_u8(dst + i * 4, p);
+    }
+
+    swizzleScalar(src + i * 4, dst + i * 4, pixels - i);
+}
+
+static inline uint8x8_t mulDiv255NEON(uint8x8_t c, uint8x8_t a) {
+    const uint16x8_t t = vmull_u8(c, a);
+    return vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+}
+
+static void premultiplyNEON(uint8_t* pixels, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t p = vld4_u8(pixels + i * 4);
+        p.val[0]      = mulDiv255NEON(p.val[0], p.val[3]);
+        p.val[1]      = mulDiv255NEON(p.val[1], p.val[3]);
+        p.val[2]      = mulDiv255NEON(p.val[2], p.val[3]);
+        vst4_u8(pixels + i * 4, p);
+    }
+
+    premultiplyScalar(pixels + i * 4, count - i);
+}
+
+#endif
+
+struct SPixelKernels {
+    const char* name = "scalar";
+    void (*swizzle)(const uint8_t* src, uint8_t* dst, size_t pixels) = swizzleScalar;
+    void (*premultiply)(uint8_t* pixels, size_t count)               = premultiplyScalar;
+};
+
+static SPixelKernels pickKernels() {
+#if defined(HYPRICONS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {"avx2", swizzleAVX2, premultiplyAVX2};
+    if (__builtin_cpu_supports("sse2"))
+        return {"sse2", swizzleSSE2, premultiplySSE2};
+#elif defined(HYPRICONS_NEON)
+    return {"neon", swizzleNEON, premultiplyNEON};
+#endif
+    return {};
+}
+
+static const SPixelKernels& kernels() {
+    static const SPixelKernels KERNELS = pickKernels();
+    return KERNELS;
+}
+
+void swizzleRedBlue(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    kernels().swizzle(src, dst, pixels);
+}
+
+void premultiplyAlpha(uint8_t* pixels, size_t count) {
+    kernels().premultiply(pixels, count);
+}
+
+const char* pixelKernelName() {
+    return kernels().name;
+}
+
+void downsampleHalf(const uint8_t* src, int width, int height, uint8_t* dst) {
+    const int    dstWidth  = width / 2;
+    const int    dstHeight = height / 2;
+    const size_t stride    = (size_t)width * 4;
+
+    for (int y = 0; y < dstHeight; y++) {
+        const uint8_t* row0 = src + (size_t)y * 2 * stride;
+        const uint8_t* row1 = row0 + stride;
+        uint8_t*       out  = dst + (size_t)y * dstWidth * 4;
+        // plain byte loop, compilers vectorize it well enough for icon sizes
+        for (int x = 0; x < dstWidth * 4; x++) {
+            const int c = (x / 4) * 8 + (x % 4);
+            out[x]      = (row0[c] + row0[c + 4] + row1[c] + row1[c + 4] + 2) >> 2;
+        }
+    }
+}
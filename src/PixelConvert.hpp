@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pixel layouts handed to the GL upload. Both are premultiplied, which is what cairo produces
+// and what Hyprland's blending (GL_ONE, GL_ONE_MINUS_SRC_ALPHA) expects.
+enum ePixelFormat : uint8_t {
+    PIXEL_FORMAT_BGRA = 0, // cairo ARGB32 on little endian
+    PIXEL_FORMAT_RGBA,
+};
+
+// Swaps the first and third byte of every pixel (BGRA <-> RGBA). src and dst may alias.
+void swizzleRedBlue(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// Converts straight alpha to premultiplied alpha in place. Alpha is the fourth byte, so the
+// channel order of the first three bytes doesn't matter.
+void premultiplyAlpha(uint8_t* pixels, size_t count);
+
+// Averages each 2x2 block of a width x height image into dst, which holds (width / 2) x (height / 2)
+// pixels; an odd last row or column is dropped. Exact on premultiplied pixels in either layout.
+void downsampleHalf(const uint8_t* src, int width, int height, uint8_t* dst);
+
+// Name of the kernel set picked for this CPU, e.g. "avx2".
+const char* pixelKernelName();
@@ -0,0 +1,186 @@
+#include "ProcessResolver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// environ can be large, the hints are set by the launcher and sit near the start
+constexpr size_t MAX_ENVIRON = 64 * 1024;
+constexpr size_t MAX_CMDLINE = 8 * 1024;
+
+// binaries that run someone else's program, named by their command line rather than themselves
+static constexpr std::array<std::string_view, 12> HOSTS = {"wine",   "wine64", "wine-preloader", "wine64-preloader", "wineserver", "java",
+                                                            "python", "python3", "perl",          "mono",             "node",       "electron"};
+
+static std::string readProcFile(pid_t pid, const char* name, size_t maxBytes) {
+    const auto path = "/proc/" + std::to_string(pid) + "/" + name;
+    const int  fd   = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return "";
+
+    // procfs reports no size, read until EOF or the cap
+    std::string contents(maxBytes, '\0');
+    size_t      used = 0;
+    while (used < maxBytes) {
+        const ssize_t n = read(fd, contents.data() + used, maxBytes - used);
+        if (n <= 0)
+            break;
+        used += n;
+    }
+    close(fd);
+
+    contents.resize(used);
+    return contents;
+}
+
+// NUL separated, as cmdline and environ are
+static std::vector<std::string_view> splitNul(std::string_view contents) {
+    std::vector<std::string_view> items;
+    size_t                        pos = 0;
+    while (pos < contents.size()) {
+        const auto end = std::min(contents.find('\0', pos), contents.size());
+        if (end > pos)
+            items.push_back(contents.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return items;
+}
+
+// windows paths count too, wine puts C:\...\app.exe in argv[0]
+static std::string_view baseName(std::string_view path) {
+    const auto slash = path.find_last_of("/\\");
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+static std::string_view stripSuffix(std::string_view name, std::string_view suffix) {
+    return name.ends_with(suffix) ? name.substr(0, name.size() - suffix.size()) : name;
+}
+
+// what a host binary is running: the .exe under wine, the jar or main class under java, the script otherwise
+static void hostedNames(std::string_view host, const std::vector<std::string_view>& args, std::vector<std::string>& out) {
+    if (host.starts_with("wine")) {
+        for (const auto& arg : args) {
+            const auto name = baseName(arg);
+            if (name.size() > 4 && (name.ends_with(".exe") || name.ends_with(".EXE"))) {
+                out.emplace_back(name);
+                out.emplace_back(name.substr(0, name.size() - 4));
+                return;
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 1; i < args.size(); i++) {
+        if (host == "java" && args[i] == "-jar" && i + 1 < args.size()) {
+            out.emplace_back(stripSuffix(baseName(args[i + 1]), ".jar"));
+            return;
+        }
+
+        if (host == "java" && (args[i] == "-cp" || args[i] == "-classpath")) {
+            i++;
+            continue;
+        }
+
+        // other options taking a separate value would be mistaken for the program, those are rare in launchers
+        if (args[i].starts_with('-'))
+            continue;
+
+        const auto name = baseName(args[i]);
+        if (host == "java") {
+            // com.example.App -> app, next to the full name
+            out.emplace_back(name);
+            out.emplace_back(name.substr(name.rfind('.') + 1));
+        } else
+            out.emplace_back(stripSuffix(stripSuffix(stripSuffix(name, ".py"), ".js"), ".pl"));
+        return;
+    }
+}
+
+static std::string toLower(std::string_view s) {
+    std::string out(s.size(), '\0');
+    std::transform(s.begin(), s.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+std::vector<std::string> CProcessResolver::keys(pid_t pid) {
+    if (pid <= 0)
+        return {};
+
+    const auto  exeLink = "/proc/" + std::to_string(pid) + "/exe";
+    struct stat st;
+    if (stat(exeLink.c_str(), &st) != 0)
+        return {};
+
+    const SExeId id{st.st_dev, st.st_ino};
+    SExe         exe;
+    bool         cached = false;
+    {
+        std::lock_guard lock(m_mutex);
+        auto            it = m_byExe.find(id);
+        if (it != m_byExe.end()) {
+            exe    = it->second;
+            cached = true;
+        }
+    }
+
+    if (!cached) {
+        std::string path(4096, '\0');
+        const auto  len = readlink(exeLink.c_str(), path.data(), path.size());
+        path.resize(len > 0 ? len : 0);
+
+        exe.name   = baseName(stripSuffix(path, " (deleted)"));
+        exe.hosted = std::find(HOSTS.begin(), HOSTS.end(), exe.name) != HOSTS.end() || exe.name.starts_with("python");
+
+        std::lock_guard lock(m_mutex);
+        if (m_byExe.size() >= MAX_CACHED)
+            m_byExe.clear();
+        m_byExe[id] = exe;
+    }
+
+    // the environment and arguments belong to this launch, two launches of one binary can differ
+    // in both; a desktop file or app ID from the launcher beats anything guessed from names
+    std::vector<std::string> found;
+    const auto               env = readProcFile(pid, "environ", MAX_ENVIRON);
+    for (const auto& var : splitNul(env)) {
+        if (var.starts_with("GIO_LAUNCHED_DESKTOP_FILE="))
+            found.emplace_back(stripSuffix(baseName(var.substr(26)), ".desktop"));
+        else if (var.starts_with("BAMF_DESKTOP_FILE_HINT="))
+            found.emplace_back(stripSuffix(baseName(var.substr(23)), ".desktop"));
+        else if (var.starts_with("FLATPAK_ID="))
+            found.emplace_back(var.substr(11));
+        else if (var.starts_with("SNAP_INSTANCE_NAME="))
+            found.emplace_back(var.substr(19));
+    }
+
+    const auto cmdline = readProcFile(pid, "cmdline", MAX_CMDLINE);
+    const auto args    = splitNul(cmdline);
+    if (exe.hosted)
+        hostedNames(exe.name, args, found);
+    else {
+        if (!args.empty())
+            found.emplace_back(baseName(args[0]));
+        found.emplace_back(exe.name);
+    }
+
+    std::vector<std::string> keys;
+    for (const auto& key : found) {
+        auto lower = toLower(key);
+        if (!lower.empty() && std::find(keys.begin(), keys.end(), lower) == keys.end())
+            keys.push_back(std::move(lower));
+    }
+
+    return keys;
+}
+
+void CProcessResolver::clear() {
+    std::lock_guard lock(m_mutex);
+    m_byExe.clear();
+}
+
+size_t CProcessResolver::cachedExecutables() const {
+    std::lock_guard lock(m_mutex);
+    return m_byExe.size();
+}
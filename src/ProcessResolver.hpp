@@ -0,0 +1,46 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Turns a window's PID into lookup keys for apps whose class says nothing useful (wine, Java,
+// many Xwayland clients): the desktop file the launcher recorded in the environment, the flatpak
+// ID or snap name, then the names on the command line and of the executable. The executable's
+// name, and whether it hosts other programs (wine, a JVM, interpreters), is cached per inode; the
+// environment and command line differ between launches of one binary and are read every time.
+// Safe to call from any thread.
+class CProcessResolver {
+  public:
+    // lowercased, most specific first; empty once the process is gone or /proc can't be read
+    std::vector<std::string> keys(pid_t pid);
+
+    void                     clear();
+    size_t                   cachedExecutables() const;
+
+  private:
+    struct SExeId {
+        dev_t dev = 0;
+        ino_t ino = 0;
+
+        bool  operator==(const SExeId&) const = default;
+    };
+
+    struct SExe {
+        std::string name;
+        bool        hosted = false; // named by its command line rather than itself
+    };
+
+    struct SExeIdHash {
+        size_t operator()(const SExeId& id) const { return std::hash<ino_t>()(id.ino) ^ (std::hash<dev_t>()(id.dev) << 1); }
+    };
+
+    static constexpr size_t                       MAX_CACHED = 256;
+
+    mutable std::mutex                            m_mutex;
+    std::unordered_map<SExeId, SExe, SExeIdHash> m_byExe;
+};
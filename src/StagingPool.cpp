@@ -0,0 +1,51 @@
+#include "StagingPool.hpp"
+
+std::vector<uint8_t> CStagingPool::acquire(size_t bytes) {
+    std::vector<uint8_t> buffer;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        // smallest retained buffer that fits
+        auto best = m_free.end();
+        for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+            if (it->capacity() >= bytes && (best == m_free.end() || it->capacity() < best->capacity()))
+                best = it;
+        }
+
+        if (best != m_free.end()) {
+            buffer = std::move(*best);
+            m_bytes -= buffer.capacity();
+            m_free.erase(best);
+        }
+    }
+
+    buffer.resize(bytes);
+    return buffer;
+}
+
+void CStagingPool::release(std::vector<uint8_t>&& buffer) {
+    if (buffer.capacity() == 0 || buffer.capacity() > MAX_BYTES)
+        return;
+
+    std::lock_guard lock(m_mutex);
+
+    // drop the smallest buffers first, large ones are the expensive ones to re-allocate
+    while (!m_free.empty() && (m_free.size() >= MAX_BUFFERS || m_bytes + buffer.capacity() > MAX_BYTES)) {
+        auto smallest = m_free.begin();
+        for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+            if (it->capacity() < smallest->capacity())
+                smallest = it;
+        }
+        m_bytes -= smallest->capacity();
+        m_free.erase(smallest);
+    }
+
+    m_bytes += buffer.capacity();
+    m_free.push_back(std::move(buffer));
+}
+
+size_t CStagingPool::retainedBytes() {
+    std::lock_guard lock(m_mutex);
+    return m_bytes;
+}
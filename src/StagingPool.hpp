@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Recycles pixel buffers between rasterization and upload so a launch doesn't allocate
+// a fresh multi-megabyte buffer each time. Safe to use from worker threads.
+class CStagingPool {
+  public:
+    std::vector<uint8_t> acquire(size_t bytes);
+    void                 release(std::vector<uint8_t>&& buffer);
+
+    size_t               retainedBytes();
+
+  private:
+    static constexpr size_t           MAX_BUFFERS = 8;
+    static constexpr size_t           MAX_BYTES   = 16 * 1024 * 1024;
+
+    std::mutex                        m_mutex;
+    std::vector<std::vector<uint8_t>> m_free;
+    size_t                            m_bytes = 0;
+};
+
+inline CStagingPool g_stagingPool;
@@ -0,0 +1,172 @@
+#include "StatsCommand.hpp"
+#include "IconOverlay.hpp"
+#include "IconLookup.hpp"
+#include "LaunchTrace.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+// one "key": value member per call, comma separated; values are numbers unless quoted by the caller
+class CJsonObject {
+  public:
+    explicit CJsonObject(std::string& out, int indent) : m_out(out), m_indent(indent) { m_out += "{"; }
+
+    void raw(const char* key, const std::string& value) {
+        m_out += m_first ? "\n" : ",\n";
+        m_out += std::string(m_indent + 4, ' ') + "\"" + key + "\": " + value;
+        m_first = false;
+    }
+    void number(const char* key, uint64_t value) { raw(key, std::to_string(value)); }
+    void string(const char* key, const std::string& value) { raw(key, "\"" + jsonEscape(value) + "\""); }
+    void close() { m_out += "\n" + std::string(m_indent, ' ') + "}"; }
+
+  private:
+    std::string& m_out;
+    int          m_indent = 0;
+    bool         m_first  = true;
+};
+
+static std::string statsJson(const SLookupStats& lookup, const SOverlayStats& overlays) {
+    std::string paths;
+    for (const auto& path : lookup.themePaths) {
+        paths += (paths.empty() ? "\"" : ", \"") + jsonEscape(path) + "\"";
+    }
+
+    std::string result;
+    CJsonObject root(result, 0);
+
+    std::string lookupJson;
+    CJsonObject lookupObject(lookupJson, 4);
+    lookupObject.string("iconTheme", lookup.iconTheme);
+    lookupObject.raw("themePaths", "[" + paths + "]");
+    lookupObject.number("desktopKeys", lookup.desktopKeys);
+    lookupObject.number("desktopAliases", lookup.desktopAliases);
+    lookupObject.number("desktopBytes", lookup.desktopBytes);
+    lookupObject.number("themeDirectories", lookup.themeDirectories);
+    lookupObject.number("themeIcons", lookup.themeIcons);
+    lookupObject.number("cachedThemes", lookup.cachedThemes);
+    lookupObject.number("memoEntries", lookup.memoEntries);
+    lookupObject.number("processCache", lookup.processCache);
+    lookupObject.number("hits", lookup.hits);
+    lookupObject.number("misses", lookup.misses);
+    lookupObject.number("negativeHits", lookup.negativeHits);
+    lookupObject.number("processHits", lookup.processHits);
+    lookupObject.number("lastRefreshMs", std::chrono::duration_cast<std::chrono::milliseconds>(lookup.lastRefresh.time_since_epoch()).count());
+    lookupObject.number("lastRefreshDurationUs", lookup.lastRefreshDuration.count());
+    lookupObject.close();
+    root.raw("lookup", lookupJson);
+
+    std::string overlaysJson;
+    CJsonObject overlaysObject(overlaysJson, 4);
+    overlaysObject.number("live", overlays.overlays);
+    overlaysObject.number("loading", overlays.loading);
+    overlaysObject.number("textures", overlays.overlayTextures);
+    overlaysObject.number("textureBytes", overlays.overlayBytes);
+    overlaysObject.number("cachedTextures", overlays.cachedTextures);
+    overlaysObject.number("cachedBytes", overlays.cachedBytes);
+    overlaysObject.number("atlasPages", overlays.atlasPages);
+    overlaysObject.number("atlasBytes", overlays.atlasBytes);
+    overlaysObject.number("atlasIcons", overlays.atlasIcons);
+    overlaysObject.number("uploadsInFlight", overlays.uploadsInFlight);
+    overlaysObject.number("uploadRingBytes", overlays.uploadRingBytes);
+    overlaysObject.close();
+    root.raw("overlays", overlaysJson);
+
+    std::string admissionJson;
+    CJsonObject admissionObject(admissionJson, 4);
+    admissionObject.number("queued", overlays.queuedLaunches);
+    admissionObject.number("offered", overlays.admission.offered);
+    admissionObject.number("admitted", overlays.admission.admitted);
+    admissionObject.number("coalesced", overlays.admission.coalesced);
+    admissionObject.number("dropped", overlays.admission.dropped);
+    admissionObject.close();
+    root.raw("admission", admissionJson);
+
+    // histograms are only filled while tracing
+    std::string intervals;
+    const auto  HISTOGRAMS = g_launchTracer.histograms();
+    for (size_t i = 0; i < HISTOGRAMS.size(); i++) {
+        const auto& h = HISTOGRAMS[i];
+        if (!h.count)
+            continue;
+
+        std::string interval;
+        CJsonObject intervalObject(interval, 12);
+        intervalObject.string("name", CLaunchTracer::intervalName(i));
+        intervalObject.number("count", h.count);
+        intervalObject.number("meanUs", h.totalNs / h.count / 1000);
+        intervalObject.number("p50Us", h.percentileUs(0.5));
+        intervalObject.number("p99Us", h.percentileUs(0.99));
+        intervalObject.number("maxUs", h.maxNs / 1000);
+        intervalObject.close();
+        intervals += (intervals.empty() ? "\n            " : ",\n            ") + interval;
+    }
+
+    std::string latencyJson;
+    CJsonObject latencyObject(latencyJson, 4);
+    latencyObject.raw("traced", g_launchTracer.enabled() ? "true" : "false");
+    latencyObject.number("cancelled", g_launchTracer.cancelled());
+    latencyObject.raw("intervals", "[" + intervals + (intervals.empty() ? "]" : "\n        ]"));
+    latencyObject.close();
+    root.raw("latency", latencyJson);
+
+    root.close();
+    return result + "\n";
+}
+
+static std::string statsText(const SLookupStats& lookup, const SOverlayStats& overlays) {
+    std::string paths;
+    for (const auto& path : lookup.themePaths) {
+        paths += (paths.empty() ? "" : ", ") + path;
+    }
+
+    const auto AGE = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - lookup.lastRefresh).count();
+
+    std::string result;
+    char        line[256];
+
+    result += "lookup:\n\ticon theme: " + lookup.iconTheme + "\n\ttheme paths: " + paths + "\n";
+    snprintf(line, sizeof(line), "\tdesktop keys: %zu (+%zu aliases), ~%zu KiB\n", lookup.desktopKeys, lookup.desktopAliases, lookup.desktopBytes / 1024);
+    result += line;
+    snprintf(line, sizeof(line), "\ttheme directories: %zu, scanned icons: %zu, themes read from icon-theme.cache: %zu\n", lookup.themeDirectories, lookup.themeIcons,
+             lookup.cachedThemes);
+    result += line;
+    snprintf(line, sizeof(line), "\thits: %lu, misses: %lu (%lu memoized), found through the process: %lu\n", (unsigned long)lookup.hits, (unsigned long)lookup.misses,
+             (unsigned long)lookup.negativeHits, (unsigned long)lookup.processHits);
+    result += line;
+    snprintf(line, sizeof(line), "\tmemo entries: %zu, executables cached: %zu\n", lookup.memoEntries, lookup.processCache);
+    result += line;
+    snprintf(line, sizeof(line), "\tlast refresh: %lds ago, took %.1f ms\n", (long)AGE, lookup.lastRefreshDuration.count() / 1000.0);
+    result += line;
+
+    snprintf(line, sizeof(line), "overlays:\n\tlive: %zu (%zu loading), drawing from %zu textures, %zu KiB\n", overlays.overlays, overlays.loading, overlays.overlayTextures,
+             overlays.overlayBytes / 1024);
+    result += line;
+    snprintf(line, sizeof(line), "\ttexture cache: %zu icons, %zu KiB\n\tatlas: %zu pages (%zu KiB), %zu icons\n", overlays.cachedTextures, overlays.cachedBytes / 1024,
+             overlays.atlasPages, overlays.atlasBytes / 1024, overlays.atlasIcons);
+    result += line;
+    snprintf(line, sizeof(line), "\tuploads in flight: %zu, upload ring: %zu KiB\n", overlays.uploadsInFlight, overlays.uploadRingBytes / 1024);
+    result += line;
+
+    snprintf(line, sizeof(line), "admission:\n\tqueued: %zu, offered: %lu, admitted: %lu, coalesced: %lu, dropped: %lu\n", overlays.queuedLaunches,
+             (unsigned long)overlays.admission.offered, (unsigned long)overlays.admission.admitted, (unsigned long)overlays.admission.coalesced,
+             (unsigned long)overlays.admission.dropped);
+    result += line;
+
+    if (g_launchTracer.enabled())
+        result += "latency:\n" + g_launchTracer.summary();
+    else
+        result += "latency: not traced, set plugin:hypricons:trace = 1\n";
+
+    return result;
+}
+
+std::string statsCommand(eHyprCtlOutputFormat format, std::string request) {
+    if (!g_pGlobalState || !g_pGlobalState->iconLookup || !g_pGlobalState->overlayManager)
+        return format == FORMAT_JSON ? "{}" : "hypricons is not initialized\n";
+
+    const auto LOOKUP   = g_pGlobalState->iconLookup->stats();
+    const auto OVERLAYS = g_pGlobalState->overlayManager->stats();
+
+    return format == FORMAT_JSON ? statsJson(LOOKUP, OVERLAYS) : statsText(LOOKUP, OVERLAYS);
+}
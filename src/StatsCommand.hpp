@@ -0,0 +1,9 @@
+#pragma once
+
+#include <hyprland/src/SharedDefs.hpp>
+
+#include <string>
+
+// `hyprctl hypricons` (or `hyprctl -j hypricons`): what the plugin holds in memory and how well
+// its lookups are doing. Runs on the compositor thread like every hyprctl command.
+std::string statsCommand(eHyprCtlOutputFormat format, std::string request);
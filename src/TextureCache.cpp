@@ -0,0 +1,155 @@
+#include "TextureCache.hpp"
+#include "IconAtlas.hpp"
+#include "StagingPool.hpp"
+
+#include <hyprland/src/render/Renderer.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+static std::atomic<bool> s_bgraUpload = false;
+
+SIconTexture::~SIconTexture() {
+    if (atlas)
+        atlas->release(slot);
+}
+
+const SIconTexture& SIconTexture::level(double targetWidth) const {
+    const SIconTexture* best = this;
+    for (const auto& mip : mips) {
+        if (mip->width < targetWidth - 0.5)
+            break;
+        best = mip.get();
+    }
+    return *best;
+}
+
+size_t STextureKeyHash::operator()(const STextureKey& key) const {
+    size_t hash = std::hash<std::string>{}(key.path);
+    hash ^= std::hash<int>{}(key.pixelSize) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+std::shared_ptr<SIconTexture> CIconTextureCache::get(const STextureKey& key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return nullptr;
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->texture;
+}
+
+void CIconTextureCache::insert(const STextureKey& key, std::shared_ptr<SIconTexture> texture) {
+    if (!texture)
+        return;
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_bytes -= it->second->texture->bytes;
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+
+    m_bytes += texture->bytes;
+    m_lru.push_front({key, std::move(texture)});
+    m_entries[key] = m_lru.begin();
+
+    trim();
+}
+
+void CIconTextureCache::trim() {
+    auto it = m_lru.end();
+    while (m_bytes > m_budget && it != m_lru.begin()) {
+        --it;
+
+        // still referenced by a live overlay
+        if (it->texture.use_count() > 1)
+            continue;
+
+        m_bytes -= it->texture->bytes;
+        m_entries.erase(it->key);
+        it = m_lru.erase(it);
+    }
+}
+
+void CIconTextureCache::clear() {
+    m_entries.clear();
+    m_lru.clear();
+    m_bytes = 0;
+}
+
+void CIconTextureCache::setBudget(size_t bytes) {
+    m_budget = bytes;
+    trim();
+}
+
+void detectUploadFormat() {
+    g_pHyprRenderer->makeEGLCurrent();
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    s_bgraUpload           = extensions && std::strstr(extensions, "GL_EXT_texture_format_BGRA8888");
+}
+
+ePixelFormat preferredUploadFormat() {
+    return s_bgraUpload ? PIXEL_FORMAT_BGRA : PIXEL_FORMAT_RGBA;
+}
+
+std::shared_ptr<SIconTexture> uploadIconTexture(const SIconImage& image, SUploadRegion* region) {
+    if (image.width <= 0 || image.height <= 0 || image.pixels.size() < (size_t)image.width * image.height * 4)
+        return nullptr;
+
+    const int      width  = image.width;
+    const int      height = image.height;
+    const size_t   bytes  = (size_t)width * height * 4;
+    const uint8_t* data   = image.pixels.data();
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    const bool   BGRA         = image.format == PIXEL_FORMAT_BGRA && s_bgraUpload;
+    size_t       bufferOffset = 0;
+    uint8_t*     mapped       = region ? region->take(bytes, bufferOffset) : nullptr;
+
+    // the extension wants BGRA as the internal format too
+    const GLenum FORMAT = BGRA ? GL_BGRA_EXT : GL_RGBA;
+
+    if (mapped) {
+        // copied into the ring now, read by the GPU later, so the call doesn't wait for a copy
+        if (image.format == PIXEL_FORMAT_BGRA && !BGRA)
+            swizzleRedBlue(data, mapped, (size_t)width * height);
+        else
+            std::memcpy(mapped, data, bytes);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, region->buffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, FORMAT, width, height, 0, FORMAT, GL_UNSIGNED_BYTE, (const void*)bufferOffset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else if (image.format == PIXEL_FORMAT_RGBA || BGRA) {
+        glTexImage2D(GL_TEXTURE_2D, 0, FORMAT, width, height, 0, FORMAT, GL_UNSIGNED_BYTE, data);
+    } else {
+        // rasterized before the upload format was known
+        auto rgba = g_stagingPool.acquire(bytes);
+        swizzleRedBlue(data, rgba.data(), (size_t)width * height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        g_stagingPool.release(std::move(rgba));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the CTexture owns the GL name from here on and deletes it once the last handle is gone
+    auto texture              = std::make_shared<SIconTexture>();
+    texture->texture          = makeShared<CTexture>();
+    texture->texture->m_texID = textureId;
+    texture->texture->m_size  = {width, height};
+    texture->width            = width;
+    texture->height           = height;
+    texture->bytes            = (size_t)width * height * 4;
+    return texture;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "globals.hpp"
+#include "IconRasterizer.hpp"
+#include "UploadRing.hpp"
+
+#include <hyprland/src/render/Texture.hpp>
+
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// pixelSize is the largest level of the pyramid, rasterized for the highest output scale
+struct STextureKey {
+    std::string path;
+    int         pixelSize = 0;
+
+    bool        operator==(const STextureKey& other) const = default;
+};
+
+struct STextureKeyHash {
+    size_t operator()(const STextureKey& key) const;
+};
+
+class CIconAtlas;
+
+// A standalone texture, or a sub-rectangle of an atlas page selected by the uv corners.
+struct SIconTexture {
+    SP<CTexture>                               texture;
+    Vector2D                                   uvTopLeft     = {0, 0};
+    Vector2D                                   uvBottomRight = {1, 1};
+    int                                        width         = 0;
+    int                                        height        = 0;
+    size_t                                     bytes         = 0; // including the mips
+
+    CIconAtlas*                                atlas = nullptr;
+    uint32_t                                   slot  = 0;
+
+    // smaller levels of the same icon, each half the size of the previous
+    std::vector<std::shared_ptr<SIconTexture>> mips;
+
+    // the smallest level at least width pixels wide, so sampling only ever shrinks by less than half
+    const SIconTexture&                        level(double width) const;
+
+    ~SIconTexture();
+};
+
+// Uploaded icon pyramids keyed by (resolved path, pixel size). Overlays keep a shared handle,
+// so entries in use are never evicted; idle entries are dropped in LRU order once over budget.
+class CIconTextureCache {
+  public:
+    std::shared_ptr<SIconTexture> get(const STextureKey& key);
+    void                          insert(const STextureKey& key, std::shared_ptr<SIconTexture> texture);
+    void                          trim();
+    void                          clear();
+
+    void                          setBudget(size_t bytes);
+    size_t                        bytesUsed() const { return m_bytes; }
+    size_t                        size() const { return m_entries.size(); }
+
+  private:
+    struct SEntry {
+        STextureKey                   key;
+        std::shared_ptr<SIconTexture> texture;
+    };
+
+    std::list<SEntry>                                                             m_lru; // front = most recently used
+    std::unordered_map<STextureKey, std::list<SEntry>::iterator, STextureKeyHash> m_entries;
+    size_t                                                                        m_bytes  = 0;
+    size_t                                                                        m_budget = 32 * 1024 * 1024;
+};
+
+// Checks once whether the driver takes BGRA uploads (GL_EXT_texture_format_BGRA8888). Must run
+// on the compositor thread; until it has, workers produce RGBA.
+void                          detectUploadFormat();
+
+// Layout workers should rasterize into so the upload needs no conversion. Safe from any thread.
+ePixelFormat                  preferredUploadFormat();
+
+// Uploads a rasterized icon into a new GL texture, from the ring region when one is given and has
+// room left. Must run on the compositor thread.
+std::shared_ptr<SIconTexture> uploadIconTexture(const SIconImage& image, SUploadRegion* region = nullptr);
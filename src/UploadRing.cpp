@@ -0,0 +1,165 @@
+#include "UploadRing.hpp"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <cstring>
+
+// keeps every span start suitably aligned for any unpack alignment and for the driver's DMA
+constexpr size_t SPAN_ALIGNMENT = 256;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint8_t* SUploadRegion::take(size_t bytes, size_t& bufferOffset) {
+    bytes = alignUp(bytes, 4);
+    if (!data || used + bytes > size)
+        return nullptr;
+
+    bufferOffset = offset + used;
+    used += bytes;
+    return data + (bufferOffset - offset);
+}
+
+CUploadRing::~CUploadRing() {
+    destroy();
+}
+
+bool CUploadRing::init(size_t capacity) {
+    destroy();
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "GL_EXT_buffer_storage"))
+        return false;
+
+    auto bufferStorage = (PFNGLBUFFERSTORAGEEXTPROC)eglGetProcAddress("glBufferStorageEXT");
+    if (!bufferStorage)
+        return false;
+
+    // coherent, so writes are visible to the GPU without an explicit flush
+    constexpr GLbitfield FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+
+    GLint                previous = 0;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previous);
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    bufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, FLAGS);
+    m_data = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, FLAGS);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, previous);
+
+    if (!m_data) {
+        destroy();
+        return false;
+    }
+
+    m_capacity = capacity;
+    m_head     = 0;
+    return true;
+}
+
+void CUploadRing::destroy() {
+    for (auto& fence : m_fences) {
+        glDeleteSync(fence.sync);
+    }
+    m_fences.clear();
+    m_spans.clear();
+
+    if (m_buffer) {
+        // a persistent mapping is released along with the buffer
+        glDeleteBuffers(1, &m_buffer);
+    }
+
+    m_buffer    = 0;
+    m_data      = nullptr;
+    m_capacity  = 0;
+    m_head      = 0;
+    m_completed = m_nextTicket - 1;
+}
+
+// Where a span of bytes would start: after the newest span, or wrapped to the front once the
+// tail of the buffer is too short. The skipped tail comes back when the spans before it retire.
+std::optional<size_t> CUploadRing::place(size_t bytes) const {
+    if (!m_data || bytes > m_capacity)
+        return std::nullopt;
+
+    if (m_spans.empty())
+        return 0;
+
+    const size_t TAIL = m_spans.front().offset;
+    if (m_head > TAIL) {
+        if (m_capacity - m_head >= bytes)
+            return m_head;
+        if (TAIL >= bytes)
+            return 0;
+        return std::nullopt;
+    }
+
+    // the head caught up with the oldest span: full when equal
+    if (TAIL - m_head >= bytes)
+        return m_head;
+    return std::nullopt;
+}
+
+bool CUploadRing::canAllocate(size_t bytes) const {
+    return place(alignUp(bytes, SPAN_ALIGNMENT)).has_value();
+}
+
+std::optional<SUploadRegion> CUploadRing::allocate(size_t bytes) {
+    bytes             = alignUp(bytes, SPAN_ALIGNMENT);
+    const auto OFFSET = place(bytes);
+    if (!OFFSET || bytes == 0)
+        return std::nullopt;
+
+    m_spans.push_back({*OFFSET, bytes, m_nextTicket});
+    m_head = *OFFSET + bytes;
+    return SUploadRegion{.buffer = m_buffer, .offset = *OFFSET, .data = m_data + *OFFSET, .size = bytes};
+}
+
+uint64_t CUploadRing::submit() {
+    const uint64_t TICKET = m_nextTicket++;
+
+    GLsync         sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!sync) {
+        // nothing to poll, finishing here beats never showing the icons
+        glFinish();
+        m_completed = TICKET;
+        return TICKET;
+    }
+
+    // without a flush the fence may never reach the GPU, and polling it would never see it signal
+    glFlush();
+    m_fences.push_back({sync, TICKET});
+    return TICKET;
+}
+
+void CUploadRing::release(const SUploadRegion& region) {
+    // only the newest span can be rolled back, and only before GL may have read from it
+    if (region.used == 0 && !m_spans.empty() && m_spans.back().offset == region.offset) {
+        m_spans.pop_back();
+        m_head = m_spans.empty() ? 0 : m_spans.back().offset + m_spans.back().size;
+        return;
+    }
+
+    submit();
+}
+
+void CUploadRing::poll() {
+    while (!m_fences.empty()) {
+        GLint status = GL_UNSIGNALED;
+        glGetSynciv(m_fences.front().sync, GL_SYNC_STATUS, 1, nullptr, &status);
+        if (status != GL_SIGNALED)
+            break;
+
+        glDeleteSync(m_fences.front().sync);
+        m_completed = m_fences.front().ticket;
+        m_fences.pop_front();
+    }
+
+    while (!m_spans.empty() && m_spans.front().ticket <= m_completed) {
+        m_spans.pop_front();
+    }
+    if (m_spans.empty())
+        m_head = 0;
+}
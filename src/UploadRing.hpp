@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GLES3/gl32.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// A span of the ring reserved for one icon's uploads, carved up level by level.
+struct SUploadRegion {
+    GLuint   buffer = 0;
+    size_t   offset = 0; // of the span in the buffer
+    uint8_t* data   = nullptr;
+    size_t   size   = 0;
+    size_t   used   = 0;
+
+    // room for the next upload, written through the pointer and passed to GL as bufferOffset;
+    // nullptr once the span is spent
+    uint8_t* take(size_t bytes, size_t& bufferOffset);
+};
+
+// Persistently mapped pixel unpack buffer used as a ring, so texture uploads read from GPU-visible
+// memory and return immediately instead of the driver copying client memory inside the frame.
+// Each batch of uploads is fenced; its span is reused only once that fence has signaled, and
+// callers poll completed() to learn when the textures are safe to show. Needs GL_EXT_buffer_storage,
+// without it ready() stays false and uploads go through client memory. Compositor thread only.
+class CUploadRing {
+  public:
+    CUploadRing() = default;
+    ~CUploadRing();
+
+    CUploadRing(const CUploadRing&)            = delete;
+    CUploadRing& operator=(const CUploadRing&) = delete;
+
+    // Needs a current context; false when the driver can't map buffers persistently.
+    bool                         init(size_t capacity);
+    void                         destroy();
+    bool                         ready() const { return m_data != nullptr; }
+    size_t                       capacity() const { return m_capacity; }
+
+    // nullopt while the spans in flight leave no contiguous room, retry after poll()
+    std::optional<SUploadRegion> allocate(size_t bytes);
+    bool                         canAllocate(size_t bytes) const;
+
+    // fences everything issued since the last submit, returns the ticket completed() answers for
+    uint64_t                     submit();
+    // for a span whose uploads failed: given back if nothing was taken from it, fenced otherwise
+    void                         release(const SUploadRegion& region);
+    // retires signaled fences without waiting for any
+    void                         poll();
+    bool                         completed(uint64_t ticket) const { return ticket <= m_completed; }
+    bool                         idle() const { return m_fences.empty(); }
+
+  private:
+    struct SSpan {
+        size_t   offset = 0;
+        size_t   size   = 0;
+        uint64_t ticket = 0;
+    };
+
+    struct SFence {
+        GLsync   sync   = nullptr;
+        uint64_t ticket = 0;
+    };
+
+    std::optional<size_t> place(size_t bytes) const;
+
+    GLuint                m_buffer   = 0;
+    uint8_t*              m_data     = nullptr;
+    size_t                m_capacity = 0;
+    size_t                m_head     = 0;
+    std::deque<SSpan>     m_spans; // oldest first
+    std::deque<SFence>    m_fences;
+    uint64_t              m_nextTicket = 1;
+    uint64_t              m_completed  = 0;
+};
@@ -0,0 +1,48 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+CWorkerPool::CWorkerPool(size_t threads) {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+        m_threads.emplace_back([this] { run(); });
+    }
+}
+
+CWorkerPool::~CWorkerPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+    }
+    m_cv.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void CWorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+
+void CWorkerPool::run() {
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_stop)
+                return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads draining a FIFO job queue. Jobs still queued at destruction are dropped.
+class CWorkerPool {
+  public:
+    explicit CWorkerPool(size_t threads);
+    ~CWorkerPool();
+
+    CWorkerPool(const CWorkerPool&)            = delete;
+    CWorkerPool& operator=(const CWorkerPool&) = delete;
+
+    void   submit(std::function<void()> job);
+    size_t threadCount() const { return m_threads.size(); }
+
+  private:
+    void                              run();
+
+    std::vector<std::thread>          m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_cv;
+    bool                              m_stop = false;
+};
@@ -2,31 +2,55 @@
 
 #include <unistd.h>
 #include <any>
+#include <algorithm>
+#include <thread>
 
 #include "globals.hpp"
 #include "IconOverlay.hpp"
 #include "IconLookup.hpp"
+#include "StatsCommand.hpp"
 
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/desktop/Window.hpp>
 #include <hyprland/src/config/ConfigManager.hpp>
 #include <hyprland/src/render/Renderer.hpp>
+#include <hyprland/src/render/OpenGL.hpp>
 #include <hyprland/src/helpers/Monitor.hpp>
+#include <hyprland/src/debug/Log.hpp>
 
-static int onTick(void* data) {
-    if (!g_pGlobalState || !g_pGlobalState->overlayManager)
-        return 0;
+static int onWatchEvent(int fd, uint32_t mask, void* data) {
+    if (g_pGlobalState && g_pGlobalState->iconLookup)
+        g_pGlobalState->iconLookup->dispatchWatchEvents();
 
-    g_pGlobalState->overlayManager->update();
+    return 0;
+}
 
-    if (g_pGlobalState->overlayManager->hasActiveOverlays()) {
-        const int TIMEOUT = g_pHyprRenderer->m_mostHzMonitor ? 1000.0 / g_pHyprRenderer->m_mostHzMonitor->m_refreshRate : 16;
-        wl_event_source_timer_update(g_pGlobalState->tickSource, TIMEOUT);
-    }
+// a burst of launches is written once, this long after the last of them
+constexpr int HISTORY_SAVE_DELAY_MS = 5000;
 
+static int onHistoryTimer(void* data) {
+    if (!g_pGlobalState || !g_pGlobalState->launchHistory || !g_pGlobalState->iconLoader)
+        return 0;
+
+    g_pGlobalState->iconLoader->submit([writer = g_pGlobalState->launchHistory->serialize()]() mutable -> CIconLoader::Completion {
+        CLaunchHistory::write(writer);
+        return nullptr;
+    });
     return 0;
 }
 
+static void recordLaunch(const std::string& iconName) {
+    if (!g_pGlobalState || !g_pGlobalState->launchHistory)
+        return;
+
+    g_pGlobalState->launchHistory->record(iconName);
+
+    if (!g_pGlobalState->historyTimer)
+        g_pGlobalState->historyTimer = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &onHistoryTimer, nullptr);
+    if (g_pGlobalState->historyTimer)
+        wl_event_source_timer_update(g_pGlobalState->historyTimer, HISTORY_SAVE_DELAY_MS);
+}
+
 static void onOpenWindow(void* self, std::any data) {
     if (!g_pGlobalState || !g_pGlobalState->enabled)
         return;
@@ -56,15 +80,9 @@ static void onOpenWindow(void* self, std::any data) {
     if (!monitor)
         return;
 
-    auto overlay = std::make_shared<CIconOverlay>(appClass, monitor);
-
-    if (overlay->getTextureId() != 0) {
-        g_pGlobalState->overlayManager->addOverlay(overlay);
-        g_pHyprRenderer->damageMonitor(monitor);
-        if (g_pGlobalState->tickSource) {
-            wl_event_source_timer_update(g_pGlobalState->tickSource, 1);
-        }
-    }
+    // the icon is resolved and rasterized off-thread once admitted; the overlay starts animating once its texture is uploaded.
+    // The pid lets wine, Java and other clients with meaningless classes still be resolved through their process
+    g_pGlobalState->overlayManager->requestLaunch(appClass, monitor, PWINDOW->getPID());
 }
 
 static void refreshConfig() {
@@ -76,19 +94,60 @@ static void refreshConfig() {
     static auto* const PFADEIN     = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:fade_in_ms")->getDataStaticPtr();
     static auto* const PHOLD       = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:hold_ms")->getDataStaticPtr();
     static auto* const PFADEOUT    = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:fade_out_ms")->getDataStaticPtr();
+    static auto* const PCACHEMB    = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:texture_cache_mb")->getDataStaticPtr();
+    static auto* const PDEADLINE   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:load_deadline_ms")->getDataStaticPtr();
+    static auto* const PPREWARM    = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:prewarm_count")->getDataStaticPtr();
+    static auto* const PTRACE      = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:trace")->getDataStaticPtr();
+    static auto* const PTRACEFILE  = (Hyprlang::STRING const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:trace_file")->getDataStaticPtr();
+    static auto* const PSHADER     = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:shader")->getDataStaticPtr();
+    static auto* const PSCALEIN    = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:scale_in")->getDataStaticPtr();
+    static auto* const PLAYOUT     = (Hyprlang::STRING const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:layout")->getDataStaticPtr();
+    static auto* const PMAXOVERLAY = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:max_overlays")->getDataStaticPtr();
+    static auto* const PMAXQUEUED  = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:max_queued")->getDataStaticPtr();
+    static auto* const PCOALESCE   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:coalesce_ms")->getDataStaticPtr();
+    static auto* const PRATE       = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:launch_rate")->getDataStaticPtr();
+    static auto* const PBURST      = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:launch_burst")->getDataStaticPtr();
+    static auto* const PDROP       = (Hyprlang::STRING const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:drop_policy")->getDataStaticPtr();
+    static auto* const PMAXWAIT    = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:hypricons:admission_wait_ms")->getDataStaticPtr();
 
     g_pGlobalState->enabled    = **PENABLED;
     g_pGlobalState->iconSize   = **PICONSIZE;
     g_pGlobalState->fadeInMs   = **PFADEIN;
     g_pGlobalState->holdMs     = **PHOLD;
     g_pGlobalState->fadeOutMs  = **PFADEOUT;
+    g_pGlobalState->textureCacheMb = **PCACHEMB;
+    g_pGlobalState->loadDeadlineMs = **PDEADLINE;
+    g_pGlobalState->prewarmCount   = **PPREWARM;
+    g_pGlobalState->shaderAnimation = **PSHADER;
+    g_pGlobalState->scaleIn         = std::max(0.0f, (float)**PSCALEIN);
+
+    const std::string layout = *PLAYOUT ? *PLAYOUT : "";
+    g_pGlobalState->layout   = layout == "row" ? ICON_LAYOUT_ROW : layout == "grid" ? ICON_LAYOUT_GRID : ICON_LAYOUT_CENTER;
+
+    const std::string traceFile = *PTRACEFILE ? *PTRACEFILE : "";
+    g_launchTracer.setDumpPath(traceFile);
+    g_launchTracer.setEnabled(**PTRACE || !traceFile.empty());
+
+    if (g_pGlobalState->overlayManager)
+        g_pGlobalState->overlayManager->textureCache().setBudget((size_t)std::max(0, g_pGlobalState->textureCacheMb) * 1024 * 1024);
+
+    const std::string drop = *PDROP ? *PDROP : "";
+    if (g_pGlobalState->overlayManager) {
+        g_pGlobalState->overlayManager->admission().configure({
+            .maxOverlays = (size_t)std::max<Hyprlang::INT>(1, **PMAXOVERLAY),
+            .maxQueued   = (size_t)std::max<Hyprlang::INT>(1, **PMAXQUEUED),
+            .coalesceMs  = (int)std::max<Hyprlang::INT>(0, **PCOALESCE),
+            .maxWaitMs   = (int)std::max<Hyprlang::INT>(0, **PMAXWAIT),
+            .rate        = (double)**PRATE,
+            .burst       = (double)std::max<Hyprlang::INT>(1, **PBURST),
+            .drop        = drop == "oldest" ? ADMISSION_DROP_OLDEST : ADMISSION_DROP_NEWEST,
+        });
+    }
 }
 
 static void onConfigReloaded(void* self, std::any data) {
+    // desktop entries and icon themes are kept current through inotify, a reload only re-reads our options
     refreshConfig();
-    if (g_pGlobalState && g_pGlobalState->iconLookup) {
-        g_pGlobalState->iconLookup->refreshCache();
-    }
 }
 
 APICALL EXPORT std::string PLUGIN_API_VERSION() {
@@ -110,12 +169,34 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
     g_pGlobalState = std::make_unique<SGlobalState>();
     g_pGlobalState->iconLookup = std::make_unique<CIconLookup>();
     g_pGlobalState->overlayManager = std::make_unique<CIconOverlayManager>();
+    g_pGlobalState->launchHistory = std::make_unique<CLaunchHistory>();
+    g_pGlobalState->launchHistory->load();
+    // counted under the icon the class resolves to, so a StartupWMClass, an Exec alias and the desktop file ID share one entry
+    g_pGlobalState->overlayManager->setLaunchResolved(&recordLaunch);
+    g_pGlobalState->iconLoader = std::make_unique<CIconLoader>(std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4));
+
+    detectUploadFormat();
 
     HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:enabled", Hyprlang::INT{1});
     HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:icon_size", Hyprlang::INT{128});
     HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:fade_in_ms", Hyprlang::INT{150});
     HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:hold_ms", Hyprlang::INT{300});
     HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:fade_out_ms", Hyprlang::INT{400});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:texture_cache_mb", Hyprlang::INT{32});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:load_deadline_ms", Hyprlang::INT{500});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:prewarm_count", Hyprlang::INT{8});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:trace", Hyprlang::INT{0});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:trace_file", Hyprlang::STRING{""});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:shader", Hyprlang::INT{0});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:scale_in", Hyprlang::FLOAT{1.0f});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:layout", Hyprlang::STRING{"center"});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:max_overlays", Hyprlang::INT{8});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:max_queued", Hyprlang::INT{16});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:coalesce_ms", Hyprlang::INT{1000});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:launch_rate", Hyprlang::FLOAT{4.0f});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:launch_burst", Hyprlang::INT{4});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:drop_policy", Hyprlang::STRING{"newest"});
+    HyprlandAPI::addConfigValue(PHANDLE, "plugin:hypricons:admission_wait_ms", Hyprlang::INT{500});
 
     static auto P1 = HyprlandAPI::registerCallbackDynamic(PHANDLE, "openWindow",
         [&](void* self, SCallbackInfo& info, std::any data) { onOpenWindow(self, data); });
@@ -125,15 +206,31 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 
     static auto P3 = HyprlandAPI::registerCallbackDynamic(PHANDLE, "render",
         [&](void* self, SCallbackInfo& info, std::any data) {
+            // "render" fires for every stage of every monitor, overlays are added once, on top of everything
+            if (std::any_cast<eRenderStage>(data) != RENDER_LAST_MOMENT)
+                return;
             if (g_pGlobalState && g_pGlobalState->overlayManager) {
-                g_pGlobalState->overlayManager->drawAll();
+                g_pGlobalState->overlayManager->drawAll(g_pHyprOpenGL->m_renderData.pMonitor.lock());
             }
         });
 
-    g_pGlobalState->tickSource = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &onTick, nullptr);
+    static auto P4 = HyprlandAPI::registerCallbackDynamic(PHANDLE, "preRender",
+        [&](void* self, SCallbackInfo& info, std::any data) {
+            if (g_pGlobalState && g_pGlobalState->overlayManager) {
+                g_pGlobalState->overlayManager->onPreRender(std::any_cast<PHLMONITOR>(data));
+            }
+        });
+
+    g_pGlobalState->statsCommand = HyprlandAPI::registerHyprCtlCommand(PHANDLE, SHyprCtlCommand{.name = "hypricons", .exact = true, .fn = statsCommand});
+
+    if (g_pGlobalState->iconLookup->watchFd() >= 0)
+        g_pGlobalState->watchSource = wl_event_loop_add_fd(g_pCompositor->m_wlEventLoop, g_pGlobalState->iconLookup->watchFd(), WL_EVENT_READABLE, &onWatchEvent, nullptr);
     HyprlandAPI::reloadConfig();
     refreshConfig();
 
+    // warmed from idle slices once startup is done, the most launched apps first
+    g_pGlobalState->overlayManager->prewarm(g_pGlobalState->launchHistory->top(std::max(0, g_pGlobalState->prewarmCount)));
+
     HyprlandAPI::addNotification(PHANDLE, "[hypricons] Initialized successfully! App icons will appear when launching apps.",
                                  CHyprColor{0.2, 1.0, 0.2, 1.0}, 5000);
 
@@ -141,9 +238,25 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 }
 
 APICALL EXPORT void PLUGIN_EXIT() {
-    if (g_pGlobalState && g_pGlobalState->tickSource) {
-        wl_event_source_remove(g_pGlobalState->tickSource);
+    if (g_pGlobalState && g_pGlobalState->watchSource) {
+        wl_event_source_remove(g_pGlobalState->watchSource);
+    }
+    if (g_pGlobalState && g_pGlobalState->statsCommand)
+        HyprlandAPI::unregisterHyprCtlCommand(PHANDLE, g_pGlobalState->statsCommand);
+    if (g_pGlobalState && g_pGlobalState->historyTimer)
+        wl_event_source_remove(g_pGlobalState->historyTimer);
+
+    // workers are joined first, so a save still queued or running can't land after this final one
+    if (g_pGlobalState && g_pGlobalState->launchHistory && g_pGlobalState->launchHistory->dirty()) {
+        g_pGlobalState->iconLoader.reset();
+        auto writer = g_pGlobalState->launchHistory->serialize();
+        CLaunchHistory::write(writer);
     }
     g_pHyprRenderer->m_renderPass.removeAllOfType("CIconPassElement");
     g_pGlobalState.reset();
+
+    if (g_launchTracer.enabled())
+        Debug::log(LOG, "[hypricons] launch latency:\n{}", g_launchTracer.summary());
+    g_launchTracer.setEnabled(false);
+    g_launchTracer.setDumpPath("");
 }